@@ -87,16 +87,140 @@ RB_METHOD(audio_##entity##Fade) \
 	}
 
 DEF_PLAY_STOP_POS( bgm )
-DEF_PLAY_STOP_POS( bgs )
 
 DEF_PLAY_STOP( me )
 
 DEF_FADE( bgm )
-DEF_FADE( bgs )
 DEF_FADE( me )
 
+RB_METHOD(audio_bgmCrossfade)
+{
+	RB_UNUSED_PARAM;
+
+	const char *filename;
+	int time;
+	int volume = 100;
+	int pitch = 100;
+	double pos = 0.0;
+
+	rb_get_args(argc, argv, "zi|iif", &filename, &time, &volume, &pitch, &pos RB_ARG_END);
+
+	GUARD_EXC( shState->audio().bgmCrossfade(filename, time, volume, pitch, pos); )
+
+	return Qnil;
+}
+
+RB_METHOD(audio_bgmQueue)
+{
+	RB_UNUSED_PARAM;
+
+	const char *filename;
+	rb_get_args(argc, argv, "z", &filename RB_ARG_END);
+
+	shState->audio().bgmQueue(filename);
+
+	return Qnil;
+}
+
+/* BGS takes an optional trailing channel argument */
+RB_METHOD(audio_bgsPlay)
+{
+	RB_UNUSED_PARAM;
+
+	const char *filename;
+	int volume = 100;
+	int pitch = 100;
+	double pos = 0.0;
+	int channel = 0;
+
+	if (rgssVer >= 3)
+		rb_get_args(argc, argv, "z|iifi", &filename, &volume, &pitch, &pos, &channel RB_ARG_END);
+	else
+		rb_get_args(argc, argv, "z|iii", &filename, &volume, &pitch, &channel RB_ARG_END);
+
+	GUARD_EXC( shState->audio().bgsPlay(filename, volume, pitch, pos, channel); )
+
+	return Qnil;
+}
+
+RB_METHOD(audio_bgsStop)
+{
+	RB_UNUSED_PARAM;
+
+	int channel = 0;
+	rb_get_args(argc, argv, "|i", &channel RB_ARG_END);
+
+	shState->audio().bgsStop(channel);
+
+	return Qnil;
+}
+
+RB_METHOD(audio_bgsFade)
+{
+	RB_UNUSED_PARAM;
+
+	int time;
+	int channel = 0;
+	rb_get_args(argc, argv, "i|i", &time, &channel RB_ARG_END);
+
+	shState->audio().bgsFade(time, channel);
+
+	return Qnil;
+}
+
+RB_METHOD(audio_bgsPos)
+{
+	RB_UNUSED_PARAM;
+
+	int channel = 0;
+	rb_get_args(argc, argv, "|i", &channel RB_ARG_END);
+
+	return rb_float_new(shState->audio().bgsPos(channel));
+}
+
 DEF_PLAY_STOP( se )
 
+/* Takes file names, or arrays of them */
+RB_METHOD(audio_sePreload)
+{
+	RB_UNUSED_PARAM;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		VALUE arg = argv[i];
+
+		if (!RB_TYPE_P(arg, RUBY_T_ARRAY))
+		{
+			shState->audio().sePreload(StringValueCStr(arg));
+			continue;
+		}
+
+		for (long j = 0; j < RARRAY_LEN(arg); ++j)
+		{
+			VALUE filename = rb_ary_entry(arg, j);
+			shState->audio().sePreload(StringValueCStr(filename));
+		}
+	}
+
+	return Qnil;
+}
+
+RB_METHOD(audio_seCacheStats)
+{
+	RB_UNUSED_PARAM;
+
+	Audio::SECacheStats stats = shState->audio().seCacheStats();
+	VALUE hash = rb_hash_new();
+
+	rb_hash_aset(hash, ID2SYM(rb_intern("hits")), UINT2NUM(stats.hits));
+	rb_hash_aset(hash, ID2SYM(rb_intern("misses")), UINT2NUM(stats.misses));
+	rb_hash_aset(hash, ID2SYM(rb_intern("evictions")), UINT2NUM(stats.evictions));
+	rb_hash_aset(hash, ID2SYM(rb_intern("decoded_bytes")), ULL2NUM(stats.decodedBytes));
+	rb_hash_aset(hash, ID2SYM(rb_intern("cached_bytes")), UINT2NUM(stats.cachedBytes));
+
+	return hash;
+}
+
 RB_METHOD(audioReset)
 {
 	RB_UNUSED_PARAM;
@@ -131,6 +255,9 @@ audioBindingInit()
 	BIND_PLAY_STOP_FADE( bgs );
 	BIND_PLAY_STOP_FADE( me  );
 
+	_rb_define_module_function(module, "bgm_crossfade", audio_bgmCrossfade);
+	_rb_define_module_function(module, "bgm_queue", audio_bgmQueue);
+
 	if (rgssVer >= 3)
 	{
 	BIND_POS( bgm );
@@ -138,6 +265,8 @@ audioBindingInit()
 	}
 
 	BIND_PLAY_STOP( se )
+	_rb_define_module_function(module, "se_preload", audio_sePreload);
+	_rb_define_module_function(module, "se_cache_stats", audio_seCacheStats);
 
 	_rb_define_module_function(module, "__reset__", audioReset);
 }
@@ -80,6 +80,8 @@ RB_METHOD(mriP);
 RB_METHOD(mkxpDataDirectory);
 RB_METHOD(mkxpPuts);
 RB_METHOD(mkxpRawKeyStates);
+RB_METHOD(mkxpPrefetch);
+RB_METHOD(mkxpPrefetchScene);
 
 RB_METHOD(mriRgssMain);
 RB_METHOD(mriRgssStop);
@@ -144,6 +146,8 @@ static void mriBindingInit()
 	_rb_define_module_function(mod, "data_directory", mkxpDataDirectory);
 	_rb_define_module_function(mod, "puts", mkxpPuts);
 	_rb_define_module_function(mod, "raw_key_states", mkxpRawKeyStates);
+	_rb_define_module_function(mod, "prefetch", mkxpPrefetch);
+	_rb_define_module_function(mod, "prefetch_scene", mkxpPrefetchScene);
 
 	rb_gv_set("MKXP", Qtrue);
 }
@@ -222,6 +226,43 @@ RB_METHOD(mkxpRawKeyStates)
 	return str;
 }
 
+/* Takes file names, or arrays of them */
+RB_METHOD(mkxpPrefetch)
+{
+	RB_UNUSED_PARAM;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		VALUE arg = argv[i];
+
+		if (!RB_TYPE_P(arg, RUBY_T_ARRAY))
+		{
+			shState->fileSystem().prefetch(StringValueCStr(arg));
+			continue;
+		}
+
+		for (long j = 0; j < RARRAY_LEN(arg); ++j)
+		{
+			VALUE filename = rb_ary_entry(arg, j);
+			shState->fileSystem().prefetch(StringValueCStr(filename));
+		}
+	}
+
+	return Qnil;
+}
+
+RB_METHOD(mkxpPrefetchScene)
+{
+	RB_UNUSED_PARAM;
+
+	const char *scene;
+	rb_get_args(argc, argv, "z", &scene RB_ARG_END);
+
+	shState->fileSystem().prefetchScene(scene);
+
+	return Qnil;
+}
+
 static VALUE rgssMainCb(VALUE block)
 {
 	rb_funcall2(block, rb_intern("call"), 0, 0);
@@ -46,7 +46,8 @@ fileIntForPath(const char *path, bool rubyExc)
 
 	try
 	{
-		shState->fileSystem().openRead(*ops, path);
+		shState->fileSystem().openReadMapped(*ops, path, false, 0, 0,
+		                                     FileSystem::ReqData);
 	}
 	catch (const Exception &e)
 	{
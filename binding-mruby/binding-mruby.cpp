@@ -266,7 +266,8 @@ runRMXPScripts(mrb_state *mrb, mrbc_context *ctx)
 	mrb_state *scriptMrb = mrb_open();
 	SDL_RWops ops;
 
-	shState->fileSystem().openRead(ops, scriptPack.c_str());
+	shState->fileSystem().openRead(ops, scriptPack.c_str(), false, 0, 0,
+	                               FileSystem::ReqData);
 
 	mrb_value scriptArray = mrb_nil_value();
 	std::string readError;
@@ -172,7 +172,8 @@ MRB_FUNCTION(kernelLoadData)
 	mrb_get_args(mrb, "z", &filename);
 
 	SDL_RWops ops;
-	GUARD_EXC( shState->fileSystem().openRead(ops, filename); )
+	GUARD_EXC( shState->fileSystem().openReadMapped(ops, filename, false, 0, 0,
+	                                                FileSystem::ReqData); )
 
 	mrb_value obj;
 	try { obj = marshalLoadInt(mrb, &ops); }
@@ -128,12 +128,15 @@ HEADERS += \
 	src/soundemitter.h \
 	src/aldatasource.h \
 	src/alstream.h \
+	src/readahead.h \
+	src/audioscheduler.h \
 	src/audiostream.h \
 	src/rgssad.h \
 	src/windowvx.h \
 	src/tilemapvx.h \
 	src/tileatlasvx.h \
 	src/sharedmidistate.h \
+	src/midicache.h \
 	src/fluid-fun.h \
 	src/sdl-util.h
 
@@ -171,6 +174,8 @@ SOURCES += \
 	src/soundemitter.cpp \
 	src/sdlsoundsource.cpp \
 	src/alstream.cpp \
+	src/readahead.cpp \
+	src/audioscheduler.cpp \
 	src/audiostream.cpp \
 	src/rgssad.cpp \
 	src/bundledfont.cpp \
@@ -180,6 +185,7 @@ SOURCES += \
 	src/tileatlasvx.cpp \
 	src/autotilesvx.cpp \
 	src/midisource.cpp \
+	src/midicache.cpp \
 	src/fluid-fun.cpp
 
 EMBED = \
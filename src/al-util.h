@@ -23,6 +23,7 @@
 #define ALUTIL_H
 
 #include <al.h>
+#include <alext.h>
 #include <SDL_audio.h>
 #include <assert.h>
 
@@ -213,6 +214,16 @@ inline uint8_t formatSampleSize(int sdlFormat)
 	return 0;
 }
 
+/* Whether buffers can take float samples (AL_EXT_FLOAT32),
+ * which spares decoders that work in float the conversion */
+inline bool haveFloatFormats()
+{
+	static const bool have = alIsExtensionPresent("AL_EXT_FLOAT32");
+
+	return have;
+}
+
+/* A sample size of 4 means float samples */
 inline ALenum chooseALFormat(int sampleSize, int channelCount)
 {
 	switch (sampleSize)
@@ -229,6 +240,12 @@ inline ALenum chooseALFormat(int sampleSize, int channelCount)
 		case 1 : return AL_FORMAT_MONO16;
 		case 2 : return AL_FORMAT_STEREO16;
 		}
+	case 4 :
+		switch (channelCount)
+		{
+		case 1 : return AL_FORMAT_MONO_FLOAT32;
+		case 2 : return AL_FORMAT_STEREO_FLOAT32;
+		}
 	default :
 		assert(!"Unhandled sample size / channel count");
 	}
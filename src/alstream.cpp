@@ -30,19 +30,25 @@
 #include "fluid-fun.h"
 #include "sdl-util.h"
 #include "debugwriter.h"
+#include "readahead.h"
+#include "util.h"
 
 #include <SDL_mutex.h>
-#include <SDL_thread.h>
-#include <SDL_timer.h>
 
 ALStream::ALStream(LoopMode loopMode,
-		           const std::string &threadId)
+		           const std::string &streamId,
+		           AudioScheduler &scheduler)
 	: looped(loopMode == Looped),
 	  state(Closed),
 	  source(0),
-	  thread(0),
+	  scheduler(scheduler),
+	  streaming(false),
+	  bufsQueued(false),
+	  bufDuration(0),
 	  preemptPause(false),
-      pitch(1.0)
+      pitch(1.0),
+      underruns(0),
+      readStalls(0)
 {
 	alSrc = AL::Source::gen();
 
@@ -55,7 +61,8 @@ ALStream::ALStream(LoopMode loopMode,
 
 	pauseMut = SDL_CreateMutex();
 
-	threadName = std::string("al_stream (") + threadId + ")";
+	task = audioTask<ALStream, &ALStream::streamData>(this);
+	name = std::string("al_stream (") + streamId + ")";
 }
 
 ALStream::~ALStream()
@@ -196,14 +203,30 @@ float ALStream::queryOffset()
 
 void ALStream::closeSource()
 {
+	if (source)
+		readStalls += readAheadStalls(srcOps);
+
+	if (underruns > 0 || readStalls > 0)
+		Debug() << name << ":" << underruns << "buffer underruns,"
+		        << readStalls << "read stalls";
+
 	delete source;
+	source = 0;
 }
 
 void ALStream::openSource(const std::string &filename)
 {
 	char ext[8];
-	shState->fileSystem().openRead(srcOps, filename.c_str(), false, ext, sizeof(ext));
+	SDL_RWops fileOps;
+	shState->fileSystem().openRead(fileOps, filename.c_str(), false, ext, sizeof(ext),
+	                               FileSystem::ReqAudio);
+
+	/* Keep the audio thread from waiting on the disk */
+	initReadAheadOps(srcOps, fileOps, shState->config().streamReadAhead * 1024);
+
 	needsRewind.clear();
+	underruns = 0;
+	readStalls = 0;
 
 	/* Try to read ogg file signature */
 	char sig[5] = { 0 };
@@ -243,18 +266,17 @@ void ALStream::openSource(const std::string &filename)
 
 void ALStream::stopStream()
 {
-	threadTermReq.set();
+	scheduler.remove(task);
 
-	if (thread)
+	if (streaming)
 	{
-		SDL_WaitThread(thread, 0);
-		thread = 0;
+		streaming = false;
 		needsRewind.set();
 	}
 
-	/* Need to stop the source _after_ the thread has terminated,
-	 * because it might have accidentally started it again before
-	 * seeing the term request */
+	/* Need to stop the source _after_ the task has been removed,
+	 * because it might have accidentally started it again while
+	 * it was still running */
 	AL::Source::stop(alSrc);
 
 	procFrames = 0;
@@ -267,13 +289,13 @@ void ALStream::startStream(float offset)
 	preemptPause = false;
 	streamInited.clear();
 	sourceExhausted.clear();
-	threadTermReq.clear();
+	bufsQueued = false;
 
 	startOffset = offset;
 	procFrames = offset * source->sampleRate();
 
-	thread = createSDLThread
-		<ALStream, &ALStream::streamData>(this, threadName);
+	streaming = true;
+	scheduler.add(task);
 }
 
 void ALStream::pauseStream()
@@ -308,7 +330,7 @@ void ALStream::checkStopped()
 	if (state != Playing)
 		return;
 
-	/* If streaming thread hasn't queued up
+	/* If the stream task hasn't queued up
 	 * buffers yet there's not point in querying
 	 * the AL source */
 	if (!streamInited)
@@ -327,123 +349,125 @@ void ALStream::checkStopped()
 	state = Stopped;
 }
 
-/* thread func */
-void ALStream::streamData()
+/* Wake up a few times per buffer played, so that
+ * processed buffers are always refilled in time */
+static uint32_t serviceInterval(uint32_t bufDuration)
 {
-	/* Fill up queue */
-	bool firstBuffer = true;
-	ALDataSource::Status status;
-
-	if (threadTermReq)
-		return;
+	return clamp<uint32_t>(bufDuration / 4, AUDIO_SLEEP, 50);
+}
 
-	if (needsRewind)
-	{
-		source->seekToOffset(startOffset);
-	}
+/* audio task */
+uint32_t ALStream::streamData()
+{
+	ALDataSource::Status status;
 
-	for (int i = 0; i < STREAM_BUFS; ++i)
+	/* Fill up queue */
+	if (!bufsQueued)
 	{
-		if (threadTermReq)
-			return;
-
-		AL::Buffer::ID buf = alBuf[i];
-
-		status = source->fillBuffer(buf);
-
-		if (status == ALDataSource::Error)
-			return;
+		bufsQueued = true;
 
-		AL::Source::queueBuffer(alSrc, buf);
-
-		if (firstBuffer)
+		if (needsRewind)
 		{
-			resumeStream();
-
-			firstBuffer = false;
-			streamInited.set();
+			source->seekToOffset(startOffset);
 		}
 
-		if (threadTermReq)
-			return;
-
-		if (status == ALDataSource::EndOfStream)
+		for (int i = 0; i < STREAM_BUFS; ++i)
 		{
-			sourceExhausted.set();
-			break;
-		}
-	}
-
-	/* Wait for buffers to be consumed, then
-	 * refill and queue them up again */
-	while (true)
-	{
-		shState->rtData().syncPoint.passSecondarySync();
-
-		ALint procBufs = AL::Source::getProcBufferCount(alSrc);
+			AL::Buffer::ID buf = alBuf[i];
 
-		while (procBufs--)
-		{
-			if (threadTermReq)
-				break;
+			status = source->fillBuffer(buf);
 
-			AL::Buffer::ID buf = AL::Source::unqueueBuffer(alSrc);
+			if (status == ALDataSource::Error)
+				return AudioScheduler::Done;
 
-			/* If something went wrong, try again later */
-			if (buf == AL::Buffer::ID(0))
-				break;
+			AL::Source::queueBuffer(alSrc, buf);
 
-			if (buf == lastBuf)
-			{
-				/* Reset the processed sample count so
-				 * querying the playback offset returns 0.0 again */
-				procFrames = source->loopStartFrames();
-				lastBuf = AL::Buffer::ID(0);
-			}
-			else
+			if (i == 0)
 			{
-				/* Add the frame count contained in this
-				 * buffer to the total count */
 				ALint bits = AL::Buffer::getBits(buf);
 				ALint size = AL::Buffer::getSize(buf);
 				ALint chan = AL::Buffer::getChannels(buf);
 
 				if (bits != 0 && chan != 0)
-					procFrames += ((size / (bits / 8)) / chan);
-			}
-
-			if (sourceExhausted)
-				continue;
+					bufDuration = ((size / (bits / 8)) / chan)
+					            * 1000 / source->sampleRate();
 
-			status = source->fillBuffer(buf);
+				resumeStream();
+				streamInited.set();
+			}
 
-			if (status == ALDataSource::Error)
+			if (status == ALDataSource::EndOfStream)
 			{
 				sourceExhausted.set();
-				return;
+				break;
 			}
+		}
 
-			AL::Source::queueBuffer(alSrc, buf);
+		return serviceInterval(bufDuration);
+	}
+
+	/* Refill and queue up again the buffers
+	 * that have been consumed */
+	ALint procBufs = AL::Source::getProcBufferCount(alSrc);
 
-			/* In case of buffer underrun,
-			 * start playing again */
-			if (AL::Source::getState(alSrc) == AL_STOPPED)
-				AL::Source::play(alSrc);
+	while (procBufs--)
+	{
+		AL::Buffer::ID buf = AL::Source::unqueueBuffer(alSrc);
 
-			/* If this was the last buffer before the data
-			 * source loop wrapped around again, mark it as
-			 * such so we can catch it and reset the processed
-			 * sample count once it gets unqueued */
-			if (status == ALDataSource::WrapAround)
-				lastBuf = buf;
+		/* If something went wrong, try again later */
+		if (buf == AL::Buffer::ID(0))
+			break;
 
-			if (status == ALDataSource::EndOfStream)
-				sourceExhausted.set();
+		if (buf == lastBuf)
+		{
+			/* Reset the processed sample count so
+			 * querying the playback offset returns 0.0 again */
+			procFrames = source->loopStartFrames();
+			lastBuf = AL::Buffer::ID(0);
+		}
+		else
+		{
+			/* Add the frame count contained in this
+			 * buffer to the total count */
+			ALint bits = AL::Buffer::getBits(buf);
+			ALint size = AL::Buffer::getSize(buf);
+			ALint chan = AL::Buffer::getChannels(buf);
+
+			if (bits != 0 && chan != 0)
+				procFrames += ((size / (bits / 8)) / chan);
 		}
 
-		if (threadTermReq)
-			break;
+		if (sourceExhausted)
+			continue;
+
+		status = source->fillBuffer(buf);
+
+		if (status == ALDataSource::Error)
+		{
+			sourceExhausted.set();
+			return AudioScheduler::Done;
+		}
 
-		SDL_Delay(AUDIO_SLEEP);
+		AL::Source::queueBuffer(alSrc, buf);
+
+		/* In case of buffer underrun,
+		 * start playing again */
+		if (AL::Source::getState(alSrc) == AL_STOPPED)
+		{
+			AL::Source::play(alSrc);
+			++underruns;
+		}
+
+		/* If this was the last buffer before the data
+		 * source loop wrapped around again, mark it as
+		 * such so we can catch it and reset the processed
+		 * sample count once it gets unqueued */
+		if (status == ALDataSource::WrapAround)
+			lastBuf = buf;
+
+		if (status == ALDataSource::EndOfStream)
+			sourceExhausted.set();
 	}
+
+	return serviceInterval(bufDuration);
 }
@@ -24,6 +24,7 @@
 
 #include "al-util.h"
 #include "sdl-util.h"
+#include "audioscheduler.h"
 
 #include <string>
 #include <SDL_rwops.h>
@@ -48,9 +49,18 @@ struct ALStream
 	State state;
 
 	ALDataSource *source;
-	SDL_Thread *thread;
 
-	std::string threadName;
+	/* Buffers are refilled by 'streamData()',
+	 * run on the audio scheduler's thread */
+	AudioScheduler &scheduler;
+	AudioTask task;
+	bool streaming;
+	bool bufsQueued;
+
+	/* Play time of one buffer, in ms */
+	uint32_t bufDuration;
+
+	std::string name;
 
 	SDL_mutex *pauseMut;
 	bool preemptPause;
@@ -61,8 +71,6 @@ struct ALStream
 	AtomicFlag streamInited;
 	AtomicFlag sourceExhausted;
 
-	AtomicFlag threadTermReq;
-
 	AtomicFlag needsRewind;
 	float startOffset;
 
@@ -76,6 +84,12 @@ struct ALStream
 
 	SDL_RWops srcOps;
 
+	/* Times the AL source ran dry mid playback, and times
+	 * reading the source had to wait on the disk. Reported
+	 * when the source is closed */
+	unsigned int underruns;
+	unsigned int readStalls;
+
 	struct
 	{
 		ALenum format;
@@ -89,7 +103,8 @@ struct ALStream
 	};
 
 	ALStream(LoopMode loopMode,
-	         const std::string &threadId);
+	         const std::string &streamId,
+	         AudioScheduler &scheduler);
 	~ALStream();
 
 	void close();
@@ -115,8 +130,8 @@ private:
 
 	void checkStopped();
 
-	/* thread func */
-	void streamData();
+	/* audio task */
+	uint32_t streamData();
 };
 
 #endif // ALSTREAM_H
@@ -22,26 +22,37 @@
 #include "audio.h"
 
 #include "audiostream.h"
+#include "audioscheduler.h"
 #include "soundemitter.h"
 #include "sharedstate.h"
 #include "sharedmidistate.h"
 #include "eventthread.h"
 #include "sdl-util.h"
+#include "exception.h"
 
 #include <string>
+#include <vector>
 
-#include <SDL_thread.h>
 #include <SDL_timer.h>
 
 struct AudioPrivate
 {
+	/* Services all streams, fades and the MeWatch.
+	 * Has to outlive everything it services */
+	AudioScheduler scheduler;
+
 	AudioStream bgm;
 	AudioStream bgs;
 	AudioStream me;
 
+	/* Additional BGS channels (channel 0 is 'bgs'),
+	 * created when first played */
+	std::vector<AudioStream*> bgsChannels;
+
 	SoundEmitter se;
 
-	SyncPoint &syncPoint;
+	/* Crossfade time for BGM switches, in ms */
+	int bgmCrossfade;
 
 	/* The 'MeWatch' is responsible for detecting
 	 * a playing ME, quickly fading out the BGM and
@@ -58,182 +69,214 @@ struct AudioPrivate
 
 	struct
 	{
-		SDL_Thread *thread;
-		AtomicFlag termReq;
+		AudioTask task;
 		MeWatchState state;
+
+		/* Ticks at the last step */
+		uint32_t lastTicks;
 	} meWatch;
 
 	AudioPrivate(RGSSThreadData &rtData)
-	    : bgm(ALStream::Looped, "bgm"),
-	      bgs(ALStream::Looped, "bgs"),
-	      me(ALStream::NotLooped, "me"),
-	      se(rtData.config),
-	      syncPoint(rtData.syncPoint)
+	    : scheduler(rtData.syncPoint),
+	      bgm(ALStream::Looped, "bgm", scheduler),
+	      bgs(ALStream::Looped, "bgs", scheduler),
+	      me(ALStream::NotLooped, "me", scheduler),
+	      bgsChannels(rtData.config.BGS.channelCount - 1),
+	      se(rtData.config, scheduler),
+	      bgmCrossfade(rtData.config.BGM.crossfade)
 	{
 		meWatch.state = MeNotPlaying;
-		meWatch.thread = createSDLThread
-			<AudioPrivate, &AudioPrivate::meWatchFun>(this, "audio_mewatch");
+		meWatch.lastTicks = SDL_GetTicks();
+		meWatch.task = audioTask<AudioPrivate, &AudioPrivate::meWatchStep>(this);
+
+		/* Sits idle until an ME is played */
+		scheduler.add(meWatch.task);
 	}
 
 	~AudioPrivate()
 	{
-		meWatch.termReq.set();
-		SDL_WaitThread(meWatch.thread, 0);
+		scheduler.remove(meWatch.task);
+
+		for (size_t i = 0; i < bgsChannels.size(); ++i)
+			delete bgsChannels[i];
 	}
 
-	void meWatchFun()
+	/* Returns null for channels out of range, or
+	 * not played yet unless 'create' is set */
+	AudioStream *getBgs(int channel, bool create = false)
 	{
-		const float fadeOutStep = 1.f / (200  / AUDIO_SLEEP);
-		const float fadeInStep  = 1.f / (1000 / AUDIO_SLEEP);
+		if (channel == 0)
+			return &bgs;
+
+		if (channel < 0 || channel > (int) bgsChannels.size())
+			return 0;
+
+		AudioStream *&stream = bgsChannels[channel-1];
 
-		while (true)
+		if (!stream && create)
 		{
-			syncPoint.passSecondarySync();
+			char id[16];
+			snprintf(id, sizeof(id), "bgs %d", channel);
 
-			if (meWatch.termReq)
-				return;
+			stream = new AudioStream(ALStream::Looped, id, scheduler);
+		}
 
-			switch (meWatch.state)
-			{
-			case MeNotPlaying:
-			{
-				me.lockStream();
+		return stream;
+	}
 
-				if (me.stream.queryState() == ALStream::Playing)
-				{
-					/* ME playing detected. -> FadeOutBGM */
-					bgm.extPaused = true;
-					meWatch.state = BgmFadingOut;
-				}
+	/* audio task */
+	uint32_t meWatchStep()
+	{
+		/* BGM fades out in 200ms and back in in 1s */
+		uint32_t now = SDL_GetTicks();
+		const float fadeOutStep = (now - meWatch.lastTicks) / 200.f;
+		const float fadeInStep  = (now - meWatch.lastTicks) / 1000.f;
+		meWatch.lastTicks = now;
 
-				me.unlockStream();
+		switch (meWatch.state)
+		{
+		case MeNotPlaying:
+		{
+			me.lockStream();
 
-				break;
+			if (me.stream->queryState() == ALStream::Playing)
+			{
+				/* ME playing detected. -> FadeOutBGM */
+				bgm.extPaused = true;
+				meWatch.state = BgmFadingOut;
 			}
 
-			case BgmFadingOut :
-			{
-				me.lockStream();
+			me.unlockStream();
 
-				if (me.stream.queryState() != ALStream::Playing)
-				{
-					/* ME has ended while fading OUT BGM. -> FadeInBGM */
-					me.unlockStream();
-					meWatch.state = BgmFadingIn;
+			break;
+		}
 
-					break;
-				}
+		case BgmFadingOut :
+		{
+			me.lockStream();
 
-				bgm.lockStream();
+			if (me.stream->queryState() != ALStream::Playing)
+			{
+				/* ME has ended while fading OUT BGM. -> FadeInBGM */
+				me.unlockStream();
+				meWatch.state = BgmFadingIn;
 
-				float vol = bgm.getVolume(AudioStream::External);
-				vol -= fadeOutStep;
+				break;
+			}
 
-				if (vol < 0 || bgm.stream.queryState() != ALStream::Playing)
-				{
-					/* Either BGM has fully faded out, or stopped midway. -> MePlaying */
-					bgm.setVolume(AudioStream::External, 0);
-					bgm.stream.pause();
-					meWatch.state = MePlaying;
-					bgm.unlockStream();
-					me.unlockStream();
-
-					break;
-				}
+			bgm.lockStream();
+
+			float vol = bgm.getVolume(AudioStream::External);
+			vol -= fadeOutStep;
 
-				bgm.setVolume(AudioStream::External, vol);
+			if (vol < 0 || bgm.stream->queryState() != ALStream::Playing)
+			{
+				/* Either BGM has fully faded out, or stopped midway. -> MePlaying */
+				bgm.setVolume(AudioStream::External, 0);
+				bgm.stream->pause();
+				meWatch.state = MePlaying;
 				bgm.unlockStream();
 				me.unlockStream();
 
 				break;
 			}
 
-			case MePlaying :
-			{
-				me.lockStream();
-
-				if (me.stream.queryState() != ALStream::Playing)
-				{
-					/* ME has ended */
-					bgm.lockStream();
+			bgm.setVolume(AudioStream::External, vol);
+			bgm.unlockStream();
+			me.unlockStream();
 
-					bgm.extPaused = false;
+			break;
+		}
 
-					ALStream::State sState = bgm.stream.queryState();
+		case MePlaying :
+		{
+			me.lockStream();
 
-					if (sState == ALStream::Paused)
-					{
-						/* BGM is paused. -> FadeInBGM */
-						bgm.stream.play();
-						meWatch.state = BgmFadingIn;
-					}
-					else
-					{
-						/* BGM is stopped. -> MeNotPlaying */
-						bgm.setVolume(AudioStream::External, 1.0);
+			if (me.stream->queryState() != ALStream::Playing)
+			{
+				/* ME has ended */
+				bgm.lockStream();
 
-						if (!bgm.noResumeStop)
-							bgm.stream.play();
+				bgm.extPaused = false;
 
-						meWatch.state = MeNotPlaying;
-					}
+				ALStream::State sState = bgm.stream->queryState();
 
-					bgm.unlockStream();
+				if (sState == ALStream::Paused)
+				{
+					/* BGM is paused. -> FadeInBGM */
+					bgm.stream->play();
+					meWatch.state = BgmFadingIn;
 				}
-
-				me.unlockStream();
-
-				break;
-			}
-
-			case BgmFadingIn :
-			{
-				bgm.lockStream();
-
-				if (bgm.stream.queryState() == ALStream::Stopped)
+				else
 				{
-					/* BGM stopped midway fade in. -> MeNotPlaying */
+					/* BGM is stopped. -> MeNotPlaying */
 					bgm.setVolume(AudioStream::External, 1.0);
-					meWatch.state = MeNotPlaying;
-					bgm.unlockStream();
 
-					break;
+					if (!bgm.noResumeStop)
+						bgm.stream->play();
+
+					meWatch.state = MeNotPlaying;
 				}
 
-				me.lockStream();
+				bgm.unlockStream();
+			}
 
-				if (me.stream.queryState() == ALStream::Playing)
-				{
-					/* ME started playing midway BGM fade in. -> FadeOutBGM */
-					bgm.extPaused = true;
-					meWatch.state = BgmFadingOut;
-					me.unlockStream();
-					bgm.unlockStream();
+			me.unlockStream();
 
-					break;
-				}
+			break;
+		}
 
-				float vol = bgm.getVolume(AudioStream::External);
-				vol += fadeInStep;
+		case BgmFadingIn :
+		{
+			bgm.lockStream();
 
-				if (vol >= 1)
-				{
-					/* BGM fully faded in. -> MeNotPlaying */
-					vol = 1.0;
-					meWatch.state = MeNotPlaying;
-				}
+			if (bgm.stream->queryState() == ALStream::Stopped)
+			{
+				/* BGM stopped midway fade in. -> MeNotPlaying */
+				bgm.setVolume(AudioStream::External, 1.0);
+				meWatch.state = MeNotPlaying;
+				bgm.unlockStream();
+
+				break;
+			}
 
-				bgm.setVolume(AudioStream::External, vol);
+			me.lockStream();
 
+			if (me.stream->queryState() == ALStream::Playing)
+			{
+				/* ME started playing midway BGM fade in. -> FadeOutBGM */
+				bgm.extPaused = true;
+				meWatch.state = BgmFadingOut;
 				me.unlockStream();
 				bgm.unlockStream();
 
 				break;
 			}
+
+			float vol = bgm.getVolume(AudioStream::External);
+			vol += fadeInStep;
+
+			if (vol >= 1)
+			{
+				/* BGM fully faded in. -> MeNotPlaying */
+				vol = 1.0;
+				meWatch.state = MeNotPlaying;
 			}
 
-			SDL_Delay(AUDIO_SLEEP);
+			bgm.setVolume(AudioStream::External, vol);
+
+			me.unlockStream();
+			bgm.unlockStream();
+
+			break;
+		}
 		}
+
+		/* Nothing to watch until the next ME is played */
+		if (meWatch.state == MeNotPlaying)
+			return AudioScheduler::Idle;
+
+		return AUDIO_SLEEP;
 	}
 };
 
@@ -247,7 +290,7 @@ void Audio::bgmPlay(const char *filename,
                     int pitch,
                     float pos)
 {
-	p->bgm.play(filename, volume, pitch, pos);
+	p->bgm.play(filename, volume, pitch, pos, p->bgmCrossfade);
 }
 
 void Audio::bgmStop()
@@ -260,23 +303,49 @@ void Audio::bgmFade(int time)
 	p->bgm.fadeOut(time);
 }
 
+void Audio::bgmCrossfade(const char *filename,
+                         int time,
+                         int volume,
+                         int pitch,
+                         float pos)
+{
+	p->bgm.play(filename, volume, pitch, pos, time);
+}
+
+void Audio::bgmQueue(const char *filename)
+{
+	p->bgm.queue(filename);
+}
+
 
 void Audio::bgsPlay(const char *filename,
                     int volume,
                     int pitch,
-                    float pos)
+                    float pos,
+                    int channel)
 {
-	p->bgs.play(filename, volume, pitch, pos);
+	AudioStream *bgs = p->getBgs(channel, true);
+
+	if (!bgs)
+		throw Exception(Exception::MKXPError, "Invalid BGS channel: %d", channel);
+
+	bgs->play(filename, volume, pitch, pos);
 }
 
-void Audio::bgsStop()
+void Audio::bgsStop(int channel)
 {
-	p->bgs.stop();
+	AudioStream *bgs = p->getBgs(channel);
+
+	if (bgs)
+		bgs->stop();
 }
 
-void Audio::bgsFade(int time)
+void Audio::bgsFade(int time, int channel)
 {
-	p->bgs.fadeOut(time);
+	AudioStream *bgs = p->getBgs(channel);
+
+	if (bgs)
+		bgs->fadeOut(time);
 }
 
 
@@ -285,6 +354,7 @@ void Audio::mePlay(const char *filename,
                    int pitch)
 {
 	p->me.play(filename, volume, pitch);
+	p->scheduler.wake(p->meWatch.task);
 }
 
 void Audio::meStop()
@@ -305,6 +375,23 @@ void Audio::sePlay(const char *filename,
 	p->se.play(filename, volume, pitch);
 }
 
+void Audio::sePreload(const char *filename)
+{
+	p->se.preload(filename);
+}
+
+Audio::SECacheStats Audio::seCacheStats()
+{
+	SECacheStats stats;
+	stats.hits = p->se.stats.hits;
+	stats.misses = p->se.stats.misses;
+	stats.evictions = p->se.stats.evictions;
+	stats.decodedBytes = p->se.stats.decodedBytes;
+	stats.cachedBytes = p->se.bufferBytes;
+
+	return stats;
+}
+
 void Audio::seStop()
 {
 	p->se.stop();
@@ -320,9 +407,11 @@ float Audio::bgmPos()
 	return p->bgm.playingOffset();
 }
 
-float Audio::bgsPos()
+float Audio::bgsPos(int channel)
 {
-	return p->bgs.playingOffset();
+	AudioStream *bgs = p->getBgs(channel);
+
+	return bgs ? bgs->playingOffset() : 0;
 }
 
 void Audio::reset()
@@ -330,6 +419,10 @@ void Audio::reset()
 	p->bgm.stop();
 	p->bgs.stop();
 	p->me.stop();
+
+	for (size_t i = 0; i < p->bgsChannels.size(); ++i)
+		if (p->bgsChannels[i])
+			p->bgsChannels[i]->stop();
 	p->se.stop();
 }
 
@@ -22,6 +22,8 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include <stdint.h>
+
 /* Concerning the 'pos' parameter:
  *   RGSS3 actually doesn't specify a format for this,
  *   it's only implied that it is a numerical value
@@ -45,12 +47,28 @@ public:
 	void bgmStop();
 	void bgmFade(int time);
 
+	/* Switches to 'filename', fading the current
+	 * BGM out while it fades in over 'time' ms */
+	void bgmCrossfade(const char *filename,
+	                  int time,
+	                  int volume = 100,
+	                  int pitch = 100,
+	                  float pos = 0);
+
+	/* Opens the BGM and buffers its beginning in the
+	 * background, so that playing it next starts
+	 * without a gap or stall */
+	void bgmQueue(const char *filename);
+
+	/* BGS can play on several channels at once,
+	 * channel 0 being the regular one */
 	void bgsPlay(const char *filename,
 	             int volume = 100,
 	             int pitch = 100,
-	             float pos = 0);
-	void bgsStop();
-	void bgsFade(int time);
+	             float pos = 0,
+	             int channel = 0);
+	void bgsStop(int channel = 0);
+	void bgsFade(int time, int channel = 0);
 
 	void mePlay(const char *filename,
 	            int volume = 100,
@@ -63,9 +81,25 @@ public:
 	            int pitch = 100);
 	void seStop();
 
+	/* Decodes the SE in the background, so that playing it
+	 * later doesn't have to (SEs that aren't ready yet
+	 * are streamed from the file instead) */
+	void sePreload(const char *filename);
+
+	struct SECacheStats
+	{
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int evictions;
+		uint64_t decodedBytes;
+		uint32_t cachedBytes;
+	};
+
+	SECacheStats seCacheStats();
+
 	void setupMidi();
 	float bgmPos();
-	float bgsPos();
+	float bgsPos(int channel = 0);
 
 	void reset();
 
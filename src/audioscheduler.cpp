@@ -0,0 +1,232 @@
+/*
+** audioscheduler.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audioscheduler.h"
+
+#include "eventthread.h"
+
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+
+/* Deadlines are SDL ticks, which wrap around */
+static bool reached(uint32_t deadline, uint32_t now)
+{
+	return static_cast<int32_t>(now - deadline) >= 0;
+}
+
+AudioScheduler::AudioScheduler(SyncPoint &syncPoint)
+    : syncPoint(syncPoint),
+      current(0),
+      threadId(0),
+      termReq(false)
+{
+	mut = SDL_CreateMutex();
+	workCond = SDL_CreateCond();
+	idleCond = SDL_CreateCond();
+
+	thread = createSDLThread
+		<AudioScheduler, &AudioScheduler::run>(this, "audio");
+}
+
+AudioScheduler::~AudioScheduler()
+{
+	SDL_LockMutex(mut);
+	termReq = true;
+	SDL_CondSignal(workCond);
+	SDL_UnlockMutex(mut);
+
+	SDL_WaitThread(thread, 0);
+
+	SDL_DestroyCond(idleCond);
+	SDL_DestroyCond(workCond);
+	SDL_DestroyMutex(mut);
+}
+
+void AudioScheduler::add(AudioTask &task, uint32_t delay)
+{
+	SDL_LockMutex(mut);
+
+	Entry *entry = find(&task);
+
+	if (!entry)
+	{
+		Entry newEntry = { &task, 0, false, false };
+		entries.push_back(newEntry);
+		entry = &entries.back();
+	}
+
+	entry->deadline = SDL_GetTicks() + delay;
+	entry->idle = false;
+
+	SDL_CondSignal(workCond);
+	SDL_UnlockMutex(mut);
+}
+
+bool AudioScheduler::remove(AudioTask &task)
+{
+	SDL_LockMutex(mut);
+
+	bool found = find(&task);
+	erase(&task);
+
+	/* Tasks may remove themselves (or have others
+	 * remove them) while being serviced */
+	if (SDL_ThreadID() != threadId)
+		while (current == &task)
+			SDL_CondWait(idleCond, mut);
+
+	SDL_UnlockMutex(mut);
+
+	return found;
+}
+
+void AudioScheduler::wake(AudioTask &task)
+{
+	SDL_LockMutex(mut);
+
+	Entry *entry = find(&task);
+
+	if (entry)
+	{
+		entry->deadline = SDL_GetTicks();
+		entry->idle = false;
+		entry->woken = (current == &task);
+
+		SDL_CondSignal(workCond);
+	}
+
+	SDL_UnlockMutex(mut);
+}
+
+bool AudioScheduler::scheduled(AudioTask &task)
+{
+	SDL_LockMutex(mut);
+	bool found = find(&task);
+	SDL_UnlockMutex(mut);
+
+	return found;
+}
+
+AudioScheduler::Entry *AudioScheduler::find(AudioTask *task)
+{
+	for (size_t i = 0; i < entries.size(); ++i)
+		if (entries[i].task == task)
+			return &entries[i];
+
+	return 0;
+}
+
+void AudioScheduler::erase(AudioTask *task)
+{
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (entries[i].task != task)
+			continue;
+
+		entries.erase(entries.begin() + i);
+		return;
+	}
+}
+
+void AudioScheduler::run()
+{
+	std::vector<AudioTask*> due;
+
+	SDL_LockMutex(mut);
+	threadId = SDL_ThreadID();
+
+	while (!termReq)
+	{
+		SDL_UnlockMutex(mut);
+		syncPoint.passSecondarySync();
+		SDL_LockMutex(mut);
+
+		uint32_t now = SDL_GetTicks();
+
+		due.clear();
+
+		for (size_t i = 0; i < entries.size(); ++i)
+			if (!entries[i].idle && reached(entries[i].deadline, now))
+				due.push_back(entries[i].task);
+
+		for (size_t i = 0; i < due.size(); ++i)
+		{
+			AudioTask *task = due[i];
+
+			/* Might have been removed while we
+			 * were servicing the ones before it */
+			if (!find(task))
+				continue;
+
+			current = task;
+			SDL_UnlockMutex(mut);
+
+			uint32_t next = task->service(task->obj);
+
+			SDL_LockMutex(mut);
+			current = 0;
+			SDL_CondBroadcast(idleCond);
+
+			Entry *entry = find(task);
+
+			if (!entry)
+				continue;
+
+			if (next == Done)
+				erase(task);
+			else if (entry->woken)
+				entry->woken = false;
+			else if (next == Idle)
+				entry->idle = true;
+			else
+				entry->deadline = SDL_GetTicks() + next;
+		}
+
+		/* Sleep until the nearest deadline */
+		bool haveDeadline = false;
+		uint32_t sleep = 0;
+		now = SDL_GetTicks();
+
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			if (entries[i].idle)
+				continue;
+
+			uint32_t left = reached(entries[i].deadline, now)
+			              ? 0 : entries[i].deadline - now;
+
+			if (!haveDeadline || left < sleep)
+				sleep = left;
+
+			haveDeadline = true;
+		}
+
+		if (termReq || (haveDeadline && sleep == 0))
+			continue;
+
+		if (haveDeadline)
+			SDL_CondWaitTimeout(workCond, mut, sleep);
+		else
+			SDL_CondWait(workCond, mut);
+	}
+
+	SDL_UnlockMutex(mut);
+}
@@ -0,0 +1,115 @@
+/*
+** audioscheduler.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AUDIOSCHEDULER_H
+#define AUDIOSCHEDULER_H
+
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <stdint.h>
+#include <vector>
+
+struct SyncPoint;
+
+/* A piece of periodic audio work, such as refilling a stream's
+ * buffers or stepping a fade. 'service' is called on the audio
+ * thread and returns the number of ms until it wants to be
+ * called again, or one of the special values below */
+struct AudioTask
+{
+	uint32_t (*service)(void *obj);
+	void *obj;
+};
+
+template<class C, uint32_t (C::*func)()>
+uint32_t __audioTaskFun(void *obj)
+{
+	return (static_cast<C*>(obj)->*func)();
+}
+
+template<class C, uint32_t (C::*func)()>
+AudioTask audioTask(C *obj)
+{
+	AudioTask task = { __audioTaskFun<C, func>, obj };
+	return task;
+}
+
+/* Runs all audio tasks on one thread, each one
+ * at its own deadline, instead of every task
+ * polling from a thread of its own */
+struct AudioScheduler
+{
+	/* Don't call again until woken up */
+	static const uint32_t Idle = 0xFFFFFFFF;
+	/* Remove the task */
+	static const uint32_t Done = 0xFFFFFFFE;
+
+	AudioScheduler(SyncPoint &syncPoint);
+	~AudioScheduler();
+
+	/* Schedules 'task' to be serviced after 'delay' ms.
+	 * If it is scheduled already, only the deadline changes */
+	void add(AudioTask &task, uint32_t delay = 0);
+
+	/* Unschedules 'task'. Once this returns, 'task' is
+	 * not being serviced, and won't be until added again.
+	 * Returns false if it wasn't scheduled in the first place */
+	bool remove(AudioTask &task);
+
+	/* Services 'task' as soon as possible, if it is scheduled */
+	void wake(AudioTask &task);
+
+	bool scheduled(AudioTask &task);
+
+private:
+	struct Entry
+	{
+		AudioTask *task;
+		uint32_t deadline;
+		bool idle;
+		/* Woken up while being serviced */
+		bool woken;
+	};
+
+	Entry *find(AudioTask *task);
+	void erase(AudioTask *task);
+
+	void run();
+
+	SyncPoint &syncPoint;
+
+	std::vector<Entry> entries;
+	/* Task currently being serviced */
+	AudioTask *current;
+
+	SDL_mutex *mut;
+	/* Signaled when there is new work */
+	SDL_cond *workCond;
+	/* Signaled after each task serviced */
+	SDL_cond *idleCond;
+
+	SDL_Thread *thread;
+	SDL_threadID threadId;
+	bool termReq;
+};
+
+#endif // AUDIOSCHEDULER_H
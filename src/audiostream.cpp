@@ -23,16 +23,20 @@
 
 #include "util.h"
 #include "exception.h"
+#include "debugwriter.h"
 
 #include <SDL_mutex.h>
 #include <SDL_thread.h>
 #include <SDL_timer.h>
 
+#include <math.h>
+
 AudioStream::AudioStream(ALStream::LoopMode loopMode,
-                         const std::string &threadId)
+                         const std::string &streamId,
+                         AudioScheduler &scheduler)
 	: extPaused(false),
 	  noResumeStop(false),
-	  stream(loopMode, threadId)
+	  scheduler(scheduler)
 {
 	current.volume = 1.0;
 	current.pitch = 1.0;
@@ -40,43 +44,64 @@ AudioStream::AudioStream(ALStream::LoopMode loopMode,
 	for (size_t i = 0; i < VolumeTypeCount; ++i)
 		volumes[i] = 1.0;
 
-	fade.thread = 0;
-	fade.threadName = std::string("audio_fadeout (") + threadId + ")";
+	stream = new ALStream(loopMode, streamId, scheduler);
+	backStream = new ALStream(loopMode, streamId + " b", scheduler);
+
+	xfade.active = false;
+	xfade.prog = 0;
+	xfade.outVolume = 1.0;
+
+	next.opening = false;
+	next.cond = SDL_CreateCond();
+	next.thread = 0;
+	next.termReq = false;
 
-	fadeIn.thread = 0;
-	fadeIn.threadName = std::string("audio_fadein (") + threadId + ")";
+	fade.task = audioTask<AudioStream, &AudioStream::fadeOutStep>(this);
+	fadeIn.task = audioTask<AudioStream, &AudioStream::fadeInStep>(this);
+	xfade.task = audioTask<AudioStream, &AudioStream::crossfadeStep>(this);
 
 	streamMut = SDL_CreateMutex();
+
+	scheduler.add(xfade.task);
 }
 
 AudioStream::~AudioStream()
 {
-	if (fade.thread)
+	if (next.thread)
 	{
-		fade.reqTerm.set();
-		SDL_WaitThread(fade.thread, 0);
-	}
+		lockStream();
+		next.termReq = true;
+		SDL_CondBroadcast(next.cond);
+		unlockStream();
 
-	if (fadeIn.thread)
-	{
-		fadeIn.rqTerm.set();
-		SDL_WaitThread(fadeIn.thread, 0);
+		SDL_WaitThread(next.thread, 0);
 	}
 
+	scheduler.remove(fade.task);
+	scheduler.remove(fadeIn.task);
+	scheduler.remove(xfade.task);
+
 	lockStream();
 
-	stream.stop();
-	stream.close();
+	stream->stop();
+	stream->close();
+	backStream->stop();
+	backStream->close();
 
 	unlockStream();
 
+	delete stream;
+	delete backStream;
+
+	SDL_DestroyCond(next.cond);
 	SDL_DestroyMutex(streamMut);
 }
 
 void AudioStream::play(const std::string &filename,
                        int volume,
                        int pitch,
-                       float offset)
+                       float offset,
+                       int crossfade)
 {
 	finiFadeOutInt();
 
@@ -85,7 +110,7 @@ void AudioStream::play(const std::string &filename,
 	float _volume = clamp<int>(volume, 0, 100) / 100.f;
 	float _pitch  = clamp<int>(pitch, 50, 150) / 100.f;
 
-	ALStream::State sState = stream.queryState();
+	ALStream::State sState = stream->queryState();
 
 	/* If all parameters match the current ones and we're
 	 * still playing, there's nothing to do */
@@ -113,14 +138,63 @@ void AudioStream::play(const std::string &filename,
 	/* Requested audio file is different from current one */
 	bool diffFile = (filename != current.filename);
 
+	/* Crossfading needs a playing track to fade out, and
+	 * a queued track can only be used if it's ready */
+	bool useBack = (crossfade > 0 && sState == ALStream::Playing && !extPaused)
+	            || isPrepared(filename);
+
+	if (diffFile && useBack)
+	{
+		try
+		{
+			switchTrack(filename, offset, crossfade);
+		}
+		catch (const Exception &e)
+		{
+			/* A running crossfade was dropped; bring
+			 * the current track back to full volume */
+			updateVolume();
+			unlockStream();
+			throw e;
+		}
+
+		setVolume(Base, _volume);
+		stream->setPitch(_pitch);
+
+		/* A crossfade fades the new track in already */
+		if (offset > 0 && !xfade.active)
+		{
+			setVolume(FadeIn, 0);
+			startFadeIn();
+		}
+
+		current.filename = filename;
+		current.volume = _volume;
+		current.pitch = _pitch;
+
+		if (!extPaused)
+			stream->play(offset);
+		else
+			noResumeStop = false;
+
+		bool crossfading = xfade.active;
+
+		unlockStream();
+
+		if (crossfading)
+			scheduler.wake(xfade.task);
+
+		return;
+	}
+
 	switch (sState)
 	{
 	case ALStream::Paused :
 	case ALStream::Playing :
-		stream.stop();
+		stream->stop();
 	case ALStream::Stopped :
 		if (diffFile)
-			stream.close();
+			stream->close();
 	case ALStream::Closed :
 		if (diffFile)
 		{
@@ -128,7 +202,7 @@ void AudioStream::play(const std::string &filename,
 			{
 				/* This will throw on errors while
 				 * opening the data source */
-				stream.open(filename);
+				stream->open(filename);
 			}
 			catch (const Exception &e)
 			{
@@ -141,7 +215,7 @@ void AudioStream::play(const std::string &filename,
 	}
 
 	setVolume(Base, _volume);
-	stream.setPitch(_pitch);
+	stream->setPitch(_pitch);
 
 	if (offset > 0)
 	{
@@ -154,7 +228,7 @@ void AudioStream::play(const std::string &filename,
 	current.pitch = _pitch;
 
 	if (!extPaused)
-		stream.play(offset);
+		stream->play(offset);
 	else
 		noResumeStop = false;
 
@@ -169,7 +243,10 @@ void AudioStream::stop()
 
 	noResumeStop = true;
 
-	stream.stop();
+	if (xfade.active)
+		endCrossfade();
+
+	stream->stop();
 
 	unlockStream();
 }
@@ -178,7 +255,7 @@ void AudioStream::fadeOut(int duration)
 {
 	lockStream();
 
-	ALStream::State sState = stream.queryState();
+	ALStream::State sState = stream->queryState();
 	noResumeStop = true;
 
 	if (fade.active)
@@ -190,7 +267,7 @@ void AudioStream::fadeOut(int duration)
 
 	if (sState == ALStream::Paused)
 	{
-		stream.stop();
+		stream->stop();
 		unlockStream();
 
 		return;
@@ -203,21 +280,26 @@ void AudioStream::fadeOut(int duration)
 		return;
 	}
 
-	if (fade.thread)
-	{
-		fade.reqFini.set();
-		SDL_WaitThread(fade.thread, 0);
-		fade.thread = 0;
-	}
-
 	fade.active.set();
 	fade.msStep = (1.0) / duration;
-	fade.reqFini.clear();
-	fade.reqTerm.clear();
 	fade.startTicks = SDL_GetTicks();
 
-	fade.thread = createSDLThread
-		<AudioStream, &AudioStream::fadeOutThread>(this, fade.threadName);
+	scheduler.add(fade.task);
+
+	unlockStream();
+}
+
+void AudioStream::queue(const std::string &filename)
+{
+	lockStream();
+
+	next.filename = filename;
+
+	if (!next.thread)
+		next.thread = createSDLThread
+			<AudioStream, &AudioStream::prepareNext>(this, "stream_prepare");
+
+	SDL_CondBroadcast(next.cond);
 
 	unlockStream();
 }
@@ -248,7 +330,7 @@ float AudioStream::getVolume(VolumeType type)
 
 float AudioStream::playingOffset()
 {
-	return stream.queryOffset();
+	return stream->queryOffset();
 }
 
 void AudioStream::updateVolume()
@@ -258,108 +340,295 @@ void AudioStream::updateVolume()
 	for (size_t i = 0; i < VolumeTypeCount; ++i)
 		vol *= volumes[i];
 
-	stream.setVolume(vol);
+	if (!xfade.active)
+	{
+		stream->setVolume(vol);
+		return;
+	}
+
+	/* Equal power crossfade, so the loudness
+	 * doesn't dip halfway through */
+	float angle = xfade.prog * (M_PI / 2);
+
+	stream->setVolume(vol * sinf(angle));
+	backStream->setVolume(GLOBAL_VOLUME * xfade.outVolume
+	                      * volumes[External] * cosf(angle));
 }
 
 void AudioStream::finiFadeOutInt()
 {
-	if (fade.thread)
+	/* Finish running fades right away, the
+	 * same way they would on their own */
+	if (scheduler.remove(fade.task))
 	{
-		fade.reqFini.set();
-		SDL_WaitThread(fade.thread, 0);
-		fade.thread = 0;
+		lockStream();
+		endFadeOut();
+		unlockStream();
+
+		fade.active.clear();
 	}
 
-	if (fadeIn.thread)
+	if (scheduler.remove(fadeIn.task))
 	{
-		fadeIn.rqFini.set();
-		SDL_WaitThread(fadeIn.thread, 0);
-		fadeIn.thread = 0;
+		lockStream();
+		setVolume(FadeIn, 1.0);
+		unlockStream();
 	}
 }
 
+void AudioStream::endFadeOut()
+{
+	if (stream->queryState() != ALStream::Paused)
+		stream->stop();
+
+	setVolume(FadeOut, 1.0);
+}
+
+/* Whether 'backStream' holds 'filename', ready to play */
+bool AudioStream::isPrepared(const std::string &filename)
+{
+	return !next.opening && !xfade.active
+	    && next.prepared == filename
+	    && backStream->queryState() == ALStream::Paused;
+}
+
+/* Brings 'filename' to the front, leaving the current track
+ * in the back to fade out or stop. Stream lock must be held */
+void AudioStream::switchTrack(const std::string &filename,
+                              float offset, int crossfade)
+{
+	/* A track being opened for a different request holds on
+	 * to 'backStream' until it's done, and no new one must
+	 * be picked up after it */
+	if (next.filename != filename)
+		next.filename.clear();
+
+	while (next.opening)
+		SDL_CondWait(next.cond, streamMut);
+
+	next.filename.clear();
+
+	/* Gain the current track is at, partway through
+	 * fading in if a crossfade is running already */
+	float curGain = 1.0;
+
+	if (xfade.active)
+	{
+		/* Drop the outgoing track, but leave the current
+		 * one where it is instead of snapping it to full */
+		curGain = sinf(xfade.prog * (M_PI / 2));
+
+		backStream->stop();
+		xfade.active = false;
+	}
+
+	if (next.prepared != filename || backStream->queryState() != ALStream::Paused)
+	{
+		backStream->close();
+		next.prepared.clear();
+
+		/* This will throw on errors while
+		 * opening the data source */
+		backStream->open(filename);
+	}
+	else if (offset > 0)
+	{
+		/* Was prebuffered from the start */
+		backStream->stop();
+	}
+
+	next.prepared.clear();
+
+	ALStream *prev = stream;
+	stream = backStream;
+	backStream = prev;
+
+	if (crossfade > 0 && backStream->queryState() == ALStream::Playing)
+	{
+		/* Fade the current track out from where it is now */
+		xfade.outVolume = curGain;
+
+		for (size_t i = 0; i < VolumeTypeCount; ++i)
+			if (i != External)
+				xfade.outVolume *= volumes[i];
+
+		xfade.active = true;
+		xfade.prog = 0;
+		xfade.startTicks = SDL_GetTicks();
+		xfade.duration = crossfade;
+	}
+	else
+	{
+		backStream->stop();
+	}
+}
+
+/* Stream lock must be held */
+void AudioStream::endCrossfade()
+{
+	backStream->stop();
+
+	xfade.active = false;
+	updateVolume();
+
+	/* A queued track might be waiting for 'backStream' */
+	SDL_CondBroadcast(next.cond);
+}
+
 void AudioStream::startFadeIn()
 {
 	/* Previous fadein should always be terminated in play() */
-	assert(!fadeIn.thread);
+	assert(!scheduler.scheduled(fadeIn.task));
 
-	fadeIn.rqFini.clear();
-	fadeIn.rqTerm.clear();
 	fadeIn.startTicks = SDL_GetTicks();
 
-	fadeIn.thread = createSDLThread
-		<AudioStream, &AudioStream::fadeInThread>(this, fadeIn.threadName);
+	scheduler.add(fadeIn.task);
 }
 
-void AudioStream::fadeOutThread()
+/* audio task */
+uint32_t AudioStream::fadeOutStep()
 {
-	while (true)
+	lockStream();
+
+	uint32_t curDur = SDL_GetTicks() - fade.startTicks;
+	float resVol = 1.0 - (curDur*fade.msStep);
+
+	if (stream->queryState() != ALStream::Playing || resVol < 0)
 	{
-		/* Just immediately terminate on request */
-		if (fade.reqTerm)
-			break;
+		endFadeOut();
+		unlockStream();
 
-		lockStream();
+		fade.active.clear();
 
-		uint32_t curDur = SDL_GetTicks() - fade.startTicks;
-		float resVol = 1.0 - (curDur*fade.msStep);
+		return AudioScheduler::Done;
+	}
 
-		ALStream::State state = stream.queryState();
+	setVolume(FadeOut, resVol);
 
-		if (state != ALStream::Playing
-		|| resVol < 0
-		|| fade.reqFini)
-		{
-			if (state != ALStream::Paused)
-				stream.stop();
+	unlockStream();
 
-			setVolume(FadeOut, 1.0);
-			unlockStream();
+	return AUDIO_SLEEP;
+}
 
-			break;
-		}
+/* audio task */
+uint32_t AudioStream::fadeInStep()
+{
+	lockStream();
+
+	/* Fade in duration is always 1 second */
+	uint32_t cur = SDL_GetTicks() - fadeIn.startTicks;
+	float prog = cur / 1000.0;
+
+	if (stream->queryState() != ALStream::Playing || prog >= 1.0)
+	{
+		setVolume(FadeIn, 1.0);
+		unlockStream();
+
+		return AudioScheduler::Done;
+	}
+
+	/* Quadratic increase (not really the same as
+	 * in RMVXA, but close enough) */
+	setVolume(FadeIn, prog*prog);
 
-		setVolume(FadeOut, resVol);
+	unlockStream();
+
+	return AUDIO_SLEEP;
+}
+
+/* audio task */
+uint32_t AudioStream::crossfadeStep()
+{
+	lockStream();
+
+	if (!xfade.active)
+	{
+		unlockStream();
+
+		return AudioScheduler::Idle;
+	}
+
+	uint32_t cur = SDL_GetTicks() - xfade.startTicks;
+	xfade.prog = static_cast<float>(cur) / xfade.duration;
 
+	if (xfade.prog >= 1.0)
+	{
+		endCrossfade();
 		unlockStream();
 
-		SDL_Delay(AUDIO_SLEEP);
+		return AudioScheduler::Idle;
 	}
 
-	fade.active.clear();
+	updateVolume();
+
+	unlockStream();
+
+	return AUDIO_SLEEP;
 }
 
-void AudioStream::fadeInThread()
+/* thread func */
+void AudioStream::prepareNext()
 {
+	lockStream();
+
 	while (true)
 	{
-		if (fadeIn.rqTerm)
+		/* 'backStream' is busy with the outgoing track
+		 * until a running crossfade ends */
+		while (!next.termReq && (next.filename.empty() || xfade.active
+		                         || next.filename == next.prepared))
+			SDL_CondWait(next.cond, streamMut);
+
+		if (next.termReq)
 			break;
 
-		lockStream();
+		std::string filename = next.filename;
+		ALStream *target = backStream;
 
-		/* Fade in duration is always 1 second */
-		uint32_t cur = SDL_GetTicks() - fadeIn.startTicks;
-		float prog = cur / 1000.0;
+		next.opening = true;
+		next.prepared.clear();
 
-		ALStream::State state = stream.queryState();
+		unlockStream();
 
-		if (state != ALStream::Playing
-		||  prog >= 1.0
-		||  fadeIn.rqFini)
-		{
-			setVolume(FadeIn, 1.0);
-			unlockStream();
+		bool opened = true;
 
-			break;
+		try
+		{
+			target->open(filename);
+		}
+		catch (const Exception &e)
+		{
+			/* Playing it will report the error to the script */
+			Debug() << "Unable to queue audio stream:" << e.msg;
+			opened = false;
 		}
 
-		/* Quadratic increase (not really the same as
-		 * in RMVXA, but close enough) */
-		setVolume(FadeIn, prog*prog);
+		lockStream();
 
-		unlockStream();
+		next.opening = false;
 
-		SDL_Delay(AUDIO_SLEEP);
+		/* Start streaming paused, which has the audio
+		 * thread fill up the buffers right away */
+		if (opened)
+		{
+			target->setVolume(0);
+			target->play();
+			target->pause();
+
+			next.prepared = filename;
+		}
+		else
+		{
+			/* A failed open leaves the old state behind */
+			target->close();
+
+			/* Don't retry it over and over */
+			if (next.filename == filename)
+				next.filename.clear();
+		}
+
+		SDL_CondBroadcast(next.cond);
 	}
+
+	unlockStream();
 }
@@ -24,6 +24,7 @@
 
 #include "al-util.h"
 #include "alstream.h"
+#include "audioscheduler.h"
 #include "sdl-util.h"
 
 #include <string>
@@ -37,7 +38,7 @@ struct AudioStream
 		float pitch;
 	} current;
 
-	/* Volumes set by external threads,
+	/* Volumes set by audio tasks,
 	 * such as for fade-in/out.
 	 * Multiplied together for final
 	 * playback volume. Used with setVolume().
@@ -78,25 +79,23 @@ struct AudioStream
 	 * soon as the ME ends, so we unset this flag. */
 	bool noResumeStop;
 
-	ALStream stream;
+	/* The track currently playing. Switching tracks can swap it
+	 * with 'backStream', which otherwise holds the outgoing track
+	 * while crossfading, or the next track opened by 'queue()' */
+	ALStream *stream;
+	ALStream *backStream;
 	SDL_mutex *streamMut;
 
+	/* Fades are stepped by tasks run on the audio scheduler */
+	AudioScheduler &scheduler;
+
 	/* Fade out */
 	struct
 	{
 		/* Fade out is in progress */
 		AtomicFlag active;
 
-		/* Request fade thread to finish and
-		 * cleanup (like it normally would) */
-		AtomicFlag reqFini;
-
-		/* Request fade thread to terminate
-		 * immediately */
-		AtomicFlag reqTerm;
-
-		SDL_Thread *thread;
-		std::string threadName;
+		AudioTask task;
 
 		/* Amount of reduced absolute volume
 		 * per ms of fade time */
@@ -109,26 +108,65 @@ struct AudioStream
 	/* Fade in */
 	struct
 	{
-		AtomicFlag rqFini;
-		AtomicFlag rqTerm;
-
-		SDL_Thread *thread;
-		std::string threadName;
+		AudioTask task;
 
 		uint32_t startTicks;
 	} fadeIn;
 
+	/* Crossfade from 'backStream' to 'stream' */
+	struct
+	{
+		bool active;
+
+		/* Sits idle between crossfades */
+		AudioTask task;
+
+		uint32_t startTicks;
+		uint32_t duration;
+
+		/* 0 to 1 over the crossfade */
+		float prog;
+
+		/* Volume the outgoing track was played at */
+		float outVolume;
+	} xfade;
+
+	/* Next track, opened into 'backStream' and prebuffered
+	 * on a background thread. The thread owns 'backStream'
+	 * while 'opening' is set */
+	struct
+	{
+		/* Requested by 'queue()', empty if none */
+		std::string filename;
+
+		/* Held by 'backStream', if it isn't the outgoing track */
+		std::string prepared;
+		bool opening;
+
+		SDL_cond *cond;
+		SDL_Thread *thread;
+		bool termReq;
+	} next;
+
 	AudioStream(ALStream::LoopMode loopMode,
-	            const std::string &threadId);
+	            const std::string &streamId,
+	            AudioScheduler &scheduler);
 	~AudioStream();
 
+	/* With a 'crossfade' duration (in ms), the current track
+	 * keeps playing and fades out while the new one fades in */
 	void play(const std::string &filename,
 	          int volume,
 	          int pitch,
-	          float offset = 0);
+	          float offset = 0,
+	          int crossfade = 0);
 	void stop();
 	void fadeOut(int duration);
 
+	/* Opens 'filename' and buffers its beginning in the
+	 * background, so that playing it next starts right away */
+	void queue(const std::string &filename);
+
 	/* Any access to this classes 'stream' member,
 	 * whether state query or modification, must be
 	 * protected by a 'lock'/'unlock' pair */
@@ -145,10 +183,21 @@ private:
 	void updateVolume();
 
 	void finiFadeOutInt();
+	void endFadeOut();
 	void startFadeIn();
 
-	void fadeOutThread();
-	void fadeInThread();
+	bool isPrepared(const std::string &filename);
+	void switchTrack(const std::string &filename,
+	                 float offset, int crossfade);
+	void endCrossfade();
+
+	/* audio tasks */
+	uint32_t fadeOutStep();
+	uint32_t fadeInStep();
+	uint32_t crossfadeStep();
+
+	/* thread func */
+	void prepareNext();
 };
 
 #endif // AUDIOSTREAM_H
@@ -238,7 +238,8 @@ Bitmap::Bitmap(const char *filename)
 	SDL_RWops ops;
 	char ext[8];
 
-	shState->fileSystem().openRead(ops, filename, false, ext, sizeof(ext));
+	shState->fileSystem().openReadMapped(ops, filename, false, ext, sizeof(ext),
+	                                     FileSystem::ReqBitmap);
 	SDL_Surface *imgSurf = IMG_LoadTyped_RW(&ops, 1, ext);
 
 	if (!imgSurf)
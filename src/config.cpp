@@ -148,6 +148,8 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(rgssVersion, int, 0) \
 	PO_DESC(debugMode, bool, false) \
 	PO_DESC(printFPS, bool, false) \
+	PO_DESC(printRenderStats, bool, false) \
+	PO_DESC(printCacheStats, bool, false) \
 	PO_DESC(winResizable, bool, false) \
 	PO_DESC(fullscreen, bool, false) \
 	PO_DESC(fixedAspectRatio, bool, true) \
@@ -158,12 +160,16 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(fixedFramerate, int, 0) \
 	PO_DESC(frameSkip, bool, true) \
 	PO_DESC(syncToRefreshrate, bool, false) \
+	PO_DESC(vsyncPacing, bool, false) \
+	PO_DESC(vsyncPacingSpin, int, 1500) \
 	PO_DESC(solidFonts, bool, false) \
 	PO_DESC(subImageFix, bool, false) \
 	PO_DESC(gameFolder, std::string, ".") \
 	PO_DESC(anyAltToggleFS, bool, false) \
 	PO_DESC(enableReset, bool, true) \
 	PO_DESC(allowSymlinks, bool, false) \
+	PO_DESC(mmapArchives, bool, true) \
+	PO_DESC(archiveIndexCache, bool, true) \
 	PO_DESC(dataPathOrg, std::string, "") \
 	PO_DESC(dataPathApp, std::string, "") \
 	PO_DESC(iconPath, std::string, "") \
@@ -172,9 +178,20 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(midi.soundFont, std::string, "") \
 	PO_DESC(midi.chorus, bool, false) \
 	PO_DESC(midi.reverb, bool, false) \
+	PO_DESC(midi.renderCache, bool, false) \
+	PO_DESC(midi.renderCacheSize, int, 512) \
 	PO_DESC(SE.sourceCount, int, 6) \
+	PO_DESC(SE.cacheSize, int, 10) \
+	PO_DESC(SE.reducedPrecision, bool, false) \
+	PO_DESC(BGM.crossfade, int, 0) \
+	PO_DESC(BGS.channelCount, int, 4) \
+	PO_DESC(streamReadAhead, int, 256) \
 	PO_DESC(customScript, std::string, "") \
 	PO_DESC(pathCache, bool, true) \
+	PO_DESC(persistPathCache, bool, false) \
+	PO_DESC(fontIndexCache, bool, true) \
+	PO_DESC(prefetchCacheSize, int, 32) \
+	PO_DESC(assetTrace, bool, false) \
 	PO_DESC(useScriptNames, bool, false)
 
 // Not gonna take your shit boost
@@ -240,6 +257,12 @@ void Config::read(int argc, char *argv[])
 	rgssVersion = clamp(rgssVersion, 0, 3);
 
 	SE.sourceCount = clamp(SE.sourceCount, 1, 64);
+	SE.cacheSize = clamp(SE.cacheSize, 1, 1024);
+	midi.renderCacheSize = clamp(midi.renderCacheSize, 16, 65536);
+	BGM.crossfade = clamp(BGM.crossfade, 0, 10000);
+	BGS.channelCount = clamp(BGS.channelCount, 1, 16);
+	streamReadAhead = clamp(streamReadAhead, 0, 16384);
+	prefetchCacheSize = clamp(prefetchCacheSize, 0, 1024);
 
 	if (!dataPathOrg.empty() && !dataPathApp.empty())
 		customDataPath = prefPath(dataPathOrg.c_str(), dataPathApp.c_str());
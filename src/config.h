@@ -74,6 +74,8 @@ struct Config
 
 	bool debugMode;
 	bool printFPS;
+	bool printRenderStats;
+	bool printCacheStats;
 
 	bool winResizable;
 	bool fullscreen;
@@ -87,6 +89,8 @@ struct Config
 	int fixedFramerate;
 	bool frameSkip;
 	bool syncToRefreshrate;
+	bool vsyncPacing;
+	int vsyncPacingSpin;
 
 	bool solidFonts;
 
@@ -96,7 +100,13 @@ struct Config
 	bool anyAltToggleFS;
 	bool enableReset;
 	bool allowSymlinks;
+	bool mmapArchives;
+	bool archiveIndexCache;
 	bool pathCache;
+	bool persistPathCache;
+	bool fontIndexCache;
+	int prefetchCacheSize;
+	bool assetTrace;
 
 	std::string dataPathOrg;
 	std::string dataPathApp;
@@ -110,13 +120,29 @@ struct Config
 		std::string soundFont;
 		bool chorus;
 		bool reverb;
+		bool renderCache;
+		int renderCacheSize;
 	} midi;
 
 	struct
 	{
 		int sourceCount;
+		int cacheSize;
+		bool reducedPrecision;
 	} SE;
 
+	struct
+	{
+		int crossfade;
+	} BGM;
+
+	struct
+	{
+		int channelCount;
+	} BGS;
+
+	int streamReadAhead;
+
 	bool useScriptNames;
 
 	std::string customScript;
@@ -54,47 +54,79 @@ bool Color::operator==(const Color &o) const
 
 const Color &Color::operator=(const Color &o)
 {
+	if (*this == o)
+		return o;
+
 	red   = o.red;
 	green = o.green;
 	blue  = o.blue;
 	alpha = o.alpha;
 	norm  = o.norm;
 
+	valueChanged();
+
 	return o;
 }
 
 void Color::set(double red, double green, double blue, double alpha)
 {
+	if (this->red   == red   &&
+	    this->green == green &&
+	    this->blue  == blue  &&
+	    this->alpha == alpha)
+		return;
+
 	this->red   = red;
 	this->green = green;
 	this->blue  = blue;
 	this->alpha = alpha;
 
 	updateInternal();
+	valueChanged();
 }
 
 void Color::setRed(double value)
 {
+	if (red == value)
+		return;
+
 	red = value;
 	norm.x = clamp<double>(value, 0, 255) / 255;
+
+	valueChanged();
 }
 
 void Color::setGreen(double value)
 {
+	if (green == value)
+		return;
+
 	green = value;
 	norm.y = clamp<double>(value, 0, 255) / 255;
+
+	valueChanged();
 }
 
 void Color::setBlue(double value)
 {
+	if (blue == value)
+		return;
+
 	blue = value;
 	norm.z = clamp<double>(value, 0, 255) / 255;
+
+	valueChanged();
 }
 
 void Color::setAlpha(double value)
 {
+	if (alpha == value)
+		return;
+
 	alpha = value;
 	norm.w = clamp<double>(value, 0, 255) / 255;
+
+	valueChanged();
 }
 
 /* Serializable */
@@ -176,6 +208,12 @@ bool Tone::operator==(const Tone &o) const
 
 void Tone::set(double red, double green, double blue, double gray)
 {
+	if (this->red   == red   &&
+	    this->green == green &&
+	    this->blue  == blue  &&
+	    this->gray  == gray)
+		return;
+
 	this->red   = red;
 	this->green = green;
 	this->blue  = blue;
@@ -187,6 +225,9 @@ void Tone::set(double red, double green, double blue, double gray)
 
 const Tone& Tone::operator=(const Tone &o)
 {
+	if (*this == o)
+		return o;
+
 	red   = o.red;
 	green = o.green;
 	blue  = o.blue;
@@ -200,6 +241,9 @@ const Tone& Tone::operator=(const Tone &o)
 
 void Tone::setRed(double value)
 {
+	if (red == value)
+		return;
+
 	red = value;
 	norm.x = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -208,6 +252,9 @@ void Tone::setRed(double value)
 
 void Tone::setGreen(double value)
 {
+	if (green == value)
+		return;
+
 	green = value;
 	norm.y = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -216,6 +263,9 @@ void Tone::setGreen(double value)
 
 void Tone::setBlue(double value)
 {
+	if (blue == value)
+		return;
+
 	blue = value;
 	norm.z = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -224,6 +274,9 @@ void Tone::setBlue(double value)
 
 void Tone::setGray(double value)
 {
+	if (gray == value)
+		return;
+
 	gray = value;
 	norm.w = (float) clamp<double>(value, 0, 255) / 255;
 
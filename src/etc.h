@@ -89,6 +89,8 @@ struct Color : public Serializable
 
 	/* Normalized (0.0 ~ 1.0) */
 	Vec4 norm;
+
+	sigc::signal<void> valueChanged;
 };
 
 struct Tone : public Serializable
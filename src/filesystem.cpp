@@ -28,20 +28,34 @@
 #include "sharedstate.h"
 #include "boost-hash.h"
 #include "debugwriter.h"
+#include "sdl-util.h"
 
 #include <physfs.h>
 
 #include <SDL_sound.h>
+#include <SDL_mutex.h>
+#include <SDL_platform.h>
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <algorithm>
 #include <vector>
+#include <list>
+#include <deque>
 
 #ifdef __APPLE__
 #include <iconv.h>
 #endif
 
+#include <sys/stat.h>
+
+#ifndef __WINDOWS__
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 struct SDLRWIoContext
 {
 	SDL_RWops *ops;
@@ -141,6 +155,153 @@ static PHYSFS_Io *createSDLRWIo(const char *filename)
 	return io;
 }
 
+static uint64_t traceMicros()
+{
+	static const double scale = 1000000.0 / SDL_GetPerformanceFrequency();
+
+	return SDL_GetPerformanceCounter() * scale;
+}
+
+/* Optional log of every asset opened, summarized at exit */
+struct AccessTrace
+{
+	/* One open of an asset. Streamed files are recorded
+	 * when closed, everything else right when opened */
+	struct Record
+	{
+		AccessTrace *trace;
+		FileSystem::Requester req;
+		const char *via;
+		std::string requested;
+		std::string resolved;
+		uint64_t bytes;
+		/* In microseconds */
+		uint64_t resolveTime;
+		uint64_t openTime;
+		uint64_t readTime;
+	};
+
+	struct FileStats
+	{
+		unsigned int opens;
+		uint64_t bytes;
+		uint64_t time;
+
+		FileStats()
+		    : opens(0), bytes(0), time(0)
+		{}
+	};
+
+	SDL_mutex *mut;
+	FILE *log;
+
+	/* Maps: resolved file name
+	 * To:   totals over all its opens */
+	BoostHash<std::string, FileStats> files;
+
+	AccessTrace(const char *logPath)
+	    : mut(SDL_CreateMutex()),
+	      log(logPath ? fopen(logPath, "w") : 0)
+	{
+		if (log)
+			fputs("requester\tvia\trequested\tresolved\tbytes\t"
+			      "resolve_us\topen_us\tread_us\n", log);
+	}
+
+	~AccessTrace()
+	{
+		report();
+
+		if (log)
+			fclose(log);
+
+		SDL_DestroyMutex(mut);
+	}
+
+	static const char *requesterName(FileSystem::Requester req)
+	{
+		static const char *names[] =
+		{
+			"other", "bitmap", "audio", "data", "font"
+		};
+
+		return names[req];
+	}
+
+	void add(const Record &rec)
+	{
+		SDL_LockMutex(mut);
+
+		FileStats &stats = files[rec.resolved];
+		stats.opens++;
+		stats.bytes += rec.bytes;
+		stats.time += rec.resolveTime + rec.openTime + rec.readTime;
+
+		if (log)
+			fprintf(log, "%s\t%s\t%s\t%s\t%llu\t%llu\t%llu\t%llu\n",
+			        requesterName(rec.req), rec.via,
+			        rec.requested.c_str(), rec.resolved.c_str(),
+			        (unsigned long long) rec.bytes,
+			        (unsigned long long) rec.resolveTime,
+			        (unsigned long long) rec.openTime,
+			        (unsigned long long) rec.readTime);
+
+		SDL_UnlockMutex(mut);
+	}
+
+	typedef std::pair<std::string, FileStats> Entry;
+
+	static bool byTime(const Entry &a, const Entry &b)
+	{
+		return a.second.time > b.second.time;
+	}
+
+	static bool byOpens(const Entry &a, const Entry &b)
+	{
+		return a.second.opens > b.second.opens;
+	}
+
+	void report()
+	{
+		std::vector<Entry> entries(files.cbegin(), files.cend());
+		unsigned int opens = 0;
+		uint64_t bytes = 0, time = 0;
+
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			opens += entries[i].second.opens;
+			bytes += entries[i].second.bytes;
+			time += entries[i].second.time;
+		}
+
+		Debug() << "Asset trace:" << opens << "opens of" << entries.size()
+		        << "files," << bytes / 1024 << "KiB," << time / 1000 << "ms";
+
+		const size_t shown = std::min<size_t>(entries.size(), 10);
+
+		std::partial_sort(entries.begin(), entries.begin() + shown,
+		                  entries.end(), byTime);
+
+		for (size_t i = 0; i < shown; ++i)
+			Debug() << "  slowest:" << entries[i].first << "-"
+			        << entries[i].second.time / 1000 << "ms over"
+			        << entries[i].second.opens << "opens";
+
+		std::partial_sort(entries.begin(), entries.begin() + shown,
+		                  entries.end(), byOpens);
+
+		for (size_t i = 0; i < shown && entries[i].second.opens > 1; ++i)
+			Debug() << "  reopened:" << entries[i].first << "-"
+			        << entries[i].second.opens << "opens,"
+			        << entries[i].second.bytes / 1024 << "KiB read";
+	}
+};
+
+static inline AccessTrace::Record *traceRecord(SDL_RWops *ops)
+{
+	return static_cast<AccessTrace::Record*>(ops->hidden.unknown.data2);
+}
+
 static inline PHYSFS_File *sdlPHYS(SDL_RWops *ops)
 {
 	return static_cast<PHYSFS_File*>(ops->hidden.unknown.data1);
@@ -191,8 +352,17 @@ static size_t SDL_RWopsRead(SDL_RWops *ops, void *buffer, size_t size, size_t ma
 	if (!f)
 		return 0;
 
+	AccessTrace::Record *rec = traceRecord(ops);
+	uint64_t start = rec ? traceMicros() : 0;
+
 	PHYSFS_sint64 result = PHYSFS_readBytes(f, buffer, size*maxnum);
 
+	if (rec)
+	{
+		rec->readTime += traceMicros() - start;
+		rec->bytes += std::max<PHYSFS_sint64>(result, 0);
+	}
+
 	return (result != -1) ? (result / size) : 0;
 }
 
@@ -218,6 +388,15 @@ static int SDL_RWopsClose(SDL_RWops *ops)
 	int result = PHYSFS_close(f);
 	ops->hidden.unknown.data1 = 0;
 
+	AccessTrace::Record *rec = traceRecord(ops);
+
+	if (rec)
+	{
+		rec->trace->add(*rec);
+		delete rec;
+		ops->hidden.unknown.data2 = 0;
+	}
+
 	return (result != 0) ? 0 : -1;
 }
 
@@ -230,6 +409,89 @@ static int SDL_RWopsCloseFree(SDL_RWops *ops)
 	return result;
 }
 
+/* Read only views of a whole file, either mapped
+ * into memory or read into a malloc'ed buffer */
+static const Uint32 SDL_RWOPS_MAPPED = SDL_RWOPS_UNKNOWN+11;
+static const Uint32 SDL_RWOPS_BUFFER = SDL_RWOPS_UNKNOWN+12;
+
+static Sint64 SDL_RWopsMemSize(SDL_RWops *ops)
+{
+	return ops->hidden.mem.stop - ops->hidden.mem.base;
+}
+
+static Sint64 SDL_RWopsMemSeek(SDL_RWops *ops, int64_t offset, int whence)
+{
+	Uint8 *base;
+
+	switch (whence)
+	{
+	default:
+	case RW_SEEK_SET :
+		base = ops->hidden.mem.base;
+		break;
+	case RW_SEEK_CUR :
+		base = ops->hidden.mem.here;
+		break;
+	case RW_SEEK_END :
+		base = ops->hidden.mem.stop;
+		break;
+	}
+
+	int64_t pos = (base - ops->hidden.mem.base) + offset;
+	pos = clamp<int64_t>(pos, 0, SDL_RWopsMemSize(ops));
+
+	ops->hidden.mem.here = ops->hidden.mem.base + pos;
+
+	return pos;
+}
+
+static size_t SDL_RWopsMemRead(SDL_RWops *ops, void *buffer, size_t size, size_t maxnum)
+{
+	if (size == 0)
+		return 0;
+
+	size_t avail = ops->hidden.mem.stop - ops->hidden.mem.here;
+	size_t num = std::min(maxnum, avail / size);
+
+	memcpy(buffer, ops->hidden.mem.here, num*size);
+	ops->hidden.mem.here += num*size;
+
+	return num;
+}
+
+static size_t SDL_RWopsMemWrite(SDL_RWops *, const void *, size_t, size_t)
+{
+	return 0;
+}
+
+static int SDL_RWopsMemClose(SDL_RWops *ops)
+{
+	Uint8 *base = ops->hidden.mem.base;
+
+	if (!base)
+		return -1;
+
+#ifndef __WINDOWS__
+	if (ops->type == SDL_RWOPS_MAPPED)
+		munmap(base, ops->hidden.mem.stop - base);
+	else
+#endif
+		free(base);
+
+	ops->hidden.mem.base = ops->hidden.mem.here = ops->hidden.mem.stop = 0;
+
+	return 0;
+}
+
+static int SDL_RWopsMemCloseFree(SDL_RWops *ops)
+{
+	int result = SDL_RWopsMemClose(ops);
+
+	SDL_FreeRW(ops);
+
+	return result;
+}
+
 /* Copies the first srcN characters from src into dst,
  * or the full string if srcN == -1. Never writes more
  * than dstMax, and guarantees dst to be null terminated.
@@ -251,220 +513,973 @@ strcpySafe(char *dst, const char *src,
 
 const Uint32 SDL_RWOPS_PHYSFS = SDL_RWOPS_UNKNOWN+10;
 
-struct FileSystemPrivate
+static uint32_t fnv1a(const char *data, size_t len)
 {
-	/* Maps: lower case filepath without extension,
-	 * To:   mixed case full filepath
-	 * This is for compatibility with games that take Windows'
-	 * case insensitivity for granted */
-	BoostHash<std::string, std::string> pathCache;
-	bool havePathCache;
+	uint32_t hash = 0x811C9DC5;
 
-	/* Attempt to locate an extension string in a filename.
-	 * Either a pointer into the input string pointing at the
-	 * extension, or null is returned */
-	const char *findExt(const char *filename)
+	for (size_t i = 0; i < len; ++i)
 	{
-		size_t len;
-
-		for (len = strlen(filename); len > 0; --len)
-		{
-			if (filename[len] == '/')
-				return 0;
-
-			if (filename[len] == '.')
-				return &filename[len+1];
-		}
-
-		return 0;
+		hash ^= (uint8_t) data[i];
+		hash *= 0x01000193;
 	}
 
-	struct CompleteFilenameData
-	{
-		bool found;
-		/* Contains the incomplete filename we're looking for;
-		 * when found, we write the complete filename into this
-		 * same buffer */
-		char *outBuf;
-		/* Length of incomplete file name */
-		size_t filenameLen;
-		/* Maximum we can write into outBuf */
-		size_t outBufN;
-	};
+	return hash;
+}
 
-	static void completeFilenameRegCB(void *data, const char *,
-	                                  const char *fname)
+/* Flat, open addressed hash table backing the path cache.
+ * All strings live in one arena, and the keys of a file
+ * (its lower case path and every stem of it) all point
+ * into the same lower case copy */
+struct PathCacheTable
+{
+	struct Slot
 	{
-		CompleteFilenameData &d = *static_cast<CompleteFilenameData*>(data);
+		uint32_t hash;
+		uint32_t keyOff;
+		uint32_t keyLen;
+		/* Offset of the mixed case path, or 'Empty' */
+		uint32_t valOff;
+	};
 
-		if (d.found)
-			return;
+	static const uint32_t Empty = 0xFFFFFFFF;
 
-		if (strncmp(d.outBuf, fname, d.filenameLen) != 0)
-			return;
+	std::vector<char> arena;
+	std::vector<Slot> slots;
+	size_t used;
 
-		/* If fname matches up to a following '.' (meaning the rest is part
-		 * of the extension), or up to a following '\0' (full match), we've
-		 * found our file */
-		switch (fname[d.filenameLen])
-		{
-		case '.' :
-			/* Overwrite the incomplete file name we looked for with
-			 * the full version containing any extensions */
-			strcpySafe(d.outBuf, fname, d.outBufN, -1);
-		case '\0' :
-			d.found = true;
-		}
+	PathCacheTable()
+	    : used(0)
+	{
+		Slot empty = { 0, 0, 0, Empty };
+		slots.resize(1024, empty);
 	}
 
-	bool completeFilenameReg(const char *filepath,
-	                         char *outBuffer,
-	                         size_t outN)
+	/* Maps the lower case version of 'path', and of it with
+	 * every possible extension cut off, to 'path' */
+	void insert(const char *path)
 	{
-		strcpySafe(outBuffer, filepath, outN, -1);
+		size_t len = strlen(path);
 
-		size_t len = strlen(outBuffer);
-		char *delim;
+		uint32_t lowOff = arena.size();
+		arena.insert(arena.end(), path, path+len+1);
 
-		/* Find the deliminator separating directory and file name */
-		for (delim = outBuffer + len; delim > outBuffer; --delim)
-			if (*delim == '/')
-				break;
+		for (size_t i = 0; i < len; ++i)
+			arena[lowOff+i] = tolower(arena[lowOff+i]);
 
-		bool root = (delim == outBuffer);
-		CompleteFilenameData d;
+		uint32_t valOff = arena.size();
+		arena.insert(arena.end(), path, path+len+1);
 
-		if (!root)
-		{
-			/* If we have such a deliminator, we set it to '\0' so we
-			 * can pass the first half to PhysFS as the directory name,
-			 * and compare all filenames against the second half */
-			d.outBuf = delim+1;
-			d.filenameLen = len - (delim - outBuffer + 1);
+		insertKey(lowOff, len, valOff);
 
-			*delim = '\0';
-		}
-		else
+		for (size_t i = len; i > 0; --i)
 		{
-			/* Otherwise the file is in the root directory */
-			d.outBuf = outBuffer;
-			d.filenameLen = len - (delim - outBuffer);
-		}
-
-		d.found = false;
-		d.outBufN = outN - (d.outBuf - outBuffer);
-
-		PHYSFS_enumerateFilesCallback(root ? "" : outBuffer, completeFilenameRegCB, &d);
+			char c = arena[lowOff+i];
 
-		if (!d.found)
-			return false;
+			if (c == '/')
+				break;
 
-		/* Now we put the deliminator back in to form the completed
-		 * file path (if required) */
-		if (delim != outBuffer)
-			*delim = '/';
+			if (c != '.')
+				continue;
 
-		return true;
+			insertKey(lowOff, i, valOff);
+		}
 	}
 
-	bool completeFilenamePC(const char *filepath,
-	                        char *outBuffer,
-	                        size_t outN)
+	bool find(const std::string &lowCase, std::string &out) const
 	{
-		std::string lowCase(filepath);
+		uint32_t hash = fnv1a(lowCase.c_str(), lowCase.size());
+		size_t mask = slots.size() - 1;
 
-		for (size_t i = 0; i < lowCase.size(); ++i)
-			lowCase[i] = tolower(lowCase[i]);
+		for (size_t i = hash & mask; slots[i].valOff != Empty; i = (i+1) & mask)
+		{
+			const Slot &slot = slots[i];
 
-		if (!pathCache.contains(lowCase))
-			return false;
+			if (slot.hash != hash || slot.keyLen != lowCase.size())
+				continue;
 
-		const std::string &fullPath = pathCache[lowCase];
-		strcpySafe(outBuffer, fullPath.c_str(), outN, fullPath.size());
+			if (memcmp(&arena[slot.keyOff], lowCase.c_str(), slot.keyLen))
+				continue;
 
-		return true;
+			out = &arena[slot.valOff];
+			return true;
+		}
+
+		return false;
 	}
 
-	bool completeFilename(const char *filepath,
-	                      char *outBuffer,
-	                      size_t outN)
+	bool operator==(const PathCacheTable &o) const
 	{
-		if (havePathCache)
-			return completeFilenamePC(filepath, outBuffer, outN);
-		else
-			return completeFilenameReg(filepath, outBuffer, outN);
+		return arena == o.arena;
 	}
 
-	PHYSFS_File *openReadHandle(const char *filename,
-	                            char *extBuf,
-	                            size_t extBufN)
+	/* Stored tables are only valid for the same search path */
+	bool load(const char *path, uint32_t searchPathHash);
+	void store(const char *path, uint32_t searchPathHash) const;
+
+private:
+	void insertKey(uint32_t keyOff, uint32_t keyLen, uint32_t valOff)
 	{
-		char found[512];
+		if ((used+1) * 2 > slots.size())
+			grow();
 
-		if (!completeFilename(filename, found, sizeof(found)))
-			throw Exception(Exception::NoFileError, "%s", filename);
+		uint32_t hash = fnv1a(&arena[keyOff], keyLen);
+		size_t mask = slots.size() - 1;
+		size_t i;
 
-		PHYSFS_File *handle = PHYSFS_openRead(found);
+		for (i = hash & mask; slots[i].valOff != Empty; i = (i+1) & mask)
+		{
+			const Slot &slot = slots[i];
 
-		if (!handle)
-			throw Exception(Exception::PHYSFSError, "PhysFS: %s", PHYSFS_getLastError());
+			/* First inserted path wins */
+			if (slot.hash == hash && slot.keyLen == keyLen
+			    && !memcmp(&arena[slot.keyOff], &arena[keyOff], keyLen))
+				return;
+		}
 
-		if (!extBuf)
-			return handle;
+		Slot slot = { hash, keyOff, keyLen, valOff };
+		slots[i] = slot;
+		++used;
+	}
 
-		for (char *q = found+strlen(found); q > found; --q)
-		{
-			if (*q == '/')
-				break;
+	void grow()
+	{
+		std::vector<Slot> old;
+		old.swap(slots);
 
-			if (*q != '.')
+		Slot empty = { 0, 0, 0, Empty };
+		slots.resize(old.size() * 2, empty);
+		size_t mask = slots.size() - 1;
+
+		for (size_t j = 0; j < old.size(); ++j)
+		{
+			if (old[j].valOff == Empty)
 				continue;
 
-			strcpySafe(extBuf, q+1, extBufN, -1);
-			break;
+			size_t i = old[j].hash & mask;
+
+			while (slots[i].valOff != Empty)
+				i = (i+1) & mask;
+
+			slots[i] = old[j];
 		}
+	}
+};
+
+#define PATH_CACHE_MAGIC "MKXPPC"
+#define PATH_CACHE_VER 1
+
+struct PathCacheHeader
+{
+	char magic[8];
+	uint32_t formVer;
+	uint32_t searchPathHash;
+	uint32_t arenaSize;
+	uint32_t slotCount;
+	uint32_t used;
+};
+
+bool PathCacheTable::load(const char *path, uint32_t searchPathHash)
+{
+	FILE *f = fopen(path, "rb");
+
+	if (!f)
+		return false;
+
+	PathCacheHeader hd;
+	bool ok = fread(&hd, sizeof(hd), 1, f) == 1
+	       && !memcmp(hd.magic, PATH_CACHE_MAGIC, sizeof(PATH_CACHE_MAGIC))
+	       && hd.formVer == PATH_CACHE_VER
+	       && hd.searchPathHash == searchPathHash
+	       /* Slot count must be a power of two */
+	       && hd.slotCount >= 2 && !(hd.slotCount & (hd.slotCount-1))
+	       && hd.used * 2 <= hd.slotCount;
+
+	if (ok)
+	{
+		arena.resize(hd.arenaSize);
+		slots.resize(hd.slotCount);
+		used = hd.used;
 
-		return handle;
+		ok = (hd.arenaSize == 0 || fread(&arena[0], hd.arenaSize, 1, f) == 1)
+		  && fread(&slots[0], sizeof(Slot), hd.slotCount, f) == hd.slotCount;
 	}
 
-	void initReadOps(PHYSFS_File *handle,
-	                 SDL_RWops &ops,
-	                 bool freeOnClose)
+	fclose(f);
+
+	/* Make sure a corrupted file can't send lookups out of bounds,
+	 * or fill up the table so probing never hits an empty slot */
+	uint32_t occupied = 0;
+
+	for (size_t i = 0; ok && i < slots.size(); ++i)
 	{
-		ops.size  = SDL_RWopsSize;
-		ops.seek  = SDL_RWopsSeek;
-		ops.read  = SDL_RWopsRead;
-		ops.write = SDL_RWopsWrite;
+		const Slot &slot = slots[i];
 
-		if (freeOnClose)
-			ops.close = SDL_RWopsCloseFree;
-		else
-			ops.close = SDL_RWopsClose;
+		if (slot.valOff == Empty)
+			continue;
 
-		ops.type = SDL_RWOPS_PHYSFS;
-		ops.hidden.unknown.data1 = handle;
+		++occupied;
+
+		ok = (uint64_t) slot.keyOff + slot.keyLen <= arena.size()
+		  && slot.valOff < arena.size();
 	}
-};
 
-FileSystem::FileSystem(const char *argv0,
-                       bool allowSymlinks)
-{
-	p = new FileSystemPrivate;
-	p->havePathCache = false;
+	if (ok)
+		ok = occupied == hd.used && occupied * 2 <= hd.slotCount;
 
-	PHYSFS_init(argv0);
+	if (ok && !arena.empty())
+		ok = arena.back() == '\0';
 
-	PHYSFS_registerArchiver(&RGSS1_Archiver);
-	PHYSFS_registerArchiver(&RGSS2_Archiver);
-	PHYSFS_registerArchiver(&RGSS3_Archiver);
+	if (!ok)
+		*this = PathCacheTable();
 
-	if (allowSymlinks)
-		PHYSFS_permitSymbolicLinks(1);
+	return ok;
 }
 
-FileSystem::~FileSystem()
+void PathCacheTable::store(const char *path, uint32_t searchPathHash) const
 {
-	delete p;
+	PathCacheHeader hd;
+	memset(&hd, 0, sizeof(hd));
+	memcpy(hd.magic, PATH_CACHE_MAGIC, sizeof(PATH_CACHE_MAGIC));
+	hd.formVer = PATH_CACHE_VER;
+	hd.searchPathHash = searchPathHash;
+	hd.arenaSize = arena.size();
+	hd.slotCount = slots.size();
+	hd.used = used;
+
+	FILE *f = fopen(path, "wb");
+
+	if (!f)
+		return;
+
+	bool ok = fwrite(&hd, sizeof(hd), 1, f) == 1
+	       && (arena.empty() || fwrite(&arena[0], arena.size(), 1, f) == 1)
+	       && fwrite(&slots[0], sizeof(Slot), slots.size(), f) == slots.size();
+
+	fclose(f);
+
+	if (!ok)
+		remove(path);
+}
+
+/* Files read ahead of time, waiting to be opened.
+ * An entry is handed over on its first open; once the
+ * byte budget runs out, the oldest entries are dropped */
+struct PrefetchCache
+{
+	struct Entry
+	{
+		std::string name;
+		Uint8 *data;
+		size_t size;
+	};
+
+	std::list<Entry> entries;
+	size_t bytes;
+	size_t budget;
+
+	/* Statistics */
+	unsigned int hits;
+	unsigned int unused;
+
+	PrefetchCache()
+	    : bytes(0), budget(0), hits(0), unused(0)
+	{}
+
+	~PrefetchCache()
+	{
+		while (!entries.empty())
+			dropOldest();
+	}
+
+	bool contains(const std::string &name) const
+	{
+		std::list<Entry>::const_iterator iter;
+
+		for (iter = entries.begin(); iter != entries.end(); ++iter)
+			if (iter->name == name)
+				return true;
+
+		return false;
+	}
+
+	/* Takes ownership of 'data' */
+	void put(const std::string &name, Uint8 *data, size_t size)
+	{
+		if (size > budget)
+		{
+			free(data);
+			return;
+		}
+
+		while (bytes + size > budget)
+			dropOldest();
+
+		Entry entry = { name, data, size };
+		entries.push_back(entry);
+		bytes += size;
+	}
+
+	/* Ownership of 'data' passes to the caller */
+	bool take(const std::string &name, Uint8 *&data, size_t &size)
+	{
+		std::list<Entry>::iterator iter;
+
+		for (iter = entries.begin(); iter != entries.end(); ++iter)
+		{
+			if (iter->name != name)
+				continue;
+
+			data = iter->data;
+			size = iter->size;
+			bytes -= size;
+			entries.erase(iter);
+			++hits;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	void dropOldest()
+	{
+		free(entries.front().data);
+		bytes -= entries.front().size;
+		entries.pop_front();
+		++unused;
+	}
+};
+
+#define PREFETCH_MANIFEST_MAGIC "MKXPPF 1"
+/* Per scene, so a stray scene can't grow the stored file forever */
+#define PREFETCH_MANIFEST_MAX 512
+
+typedef BoostHash<std::string, std::vector<std::string> > ManifestHash;
+
+/* Manifests are stored as plain text: after the magic line,
+ * each scene is introduced by a line starting with '@',
+ * followed by the files recorded for it, one per line */
+static void loadManifests(const char *path, ManifestHash &manifests)
+{
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return;
+
+	char line[512];
+	std::vector<std::string> *files = 0;
+
+	if (!fgets(line, sizeof(line), f)
+	    || strncmp(line, PREFETCH_MANIFEST_MAGIC "\n", sizeof(line)) != 0)
+	{
+		fclose(f);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), f))
+	{
+		size_t len = strlen(line);
+
+		if (len == 0 || line[len-1] != '\n')
+			break;
+
+		line[len-1] = '\0';
+
+		if (line[0] == '@')
+			files = &manifests[line+1];
+		else if (files && files->size() < PREFETCH_MANIFEST_MAX)
+			files->push_back(line);
+	}
+
+	fclose(f);
+}
+
+static void storeManifests(const char *path, const ManifestHash &manifests)
+{
+	FILE *f = fopen(path, "w");
+
+	if (!f)
+		return;
+
+	fputs(PREFETCH_MANIFEST_MAGIC "\n", f);
+
+	for (ManifestHash::const_iterator iter = manifests.cbegin();
+	     iter != manifests.cend(); ++iter)
+	{
+		fprintf(f, "@%s\n", iter->first.c_str());
+
+		for (size_t i = 0; i < iter->second.size(); ++i)
+			fprintf(f, "%s\n", iter->second[i].c_str());
+	}
+
+	if (fclose(f) != 0)
+		remove(path);
+}
+
+struct FileSystemPrivate
+{
+	/* Maps: lower case filepath without extension,
+	 * To:   mixed case full filepath
+	 * This is for compatibility with games that take Windows'
+	 * case insensitivity for granted.
+	 * The cache is built on a background thread; until then,
+	 * lookups are served from the table stored by a previous
+	 * run (if any), and wait for the build when they miss */
+	PathCacheTable *pathCache;
+	bool havePathCache;
+
+	/* 'pathCache' is the stored table, whose entries might
+	 * have been renamed or deleted since it was built */
+	bool pathCacheStored;
+
+	SDL_mutex *pathCacheMut;
+	SDL_Thread *pathCacheThread;
+	SDL_mutex *pathCacheJoinMut;
+
+	/* Where to store the built table, empty if not at all */
+	std::string pathCacheStore;
+	uint32_t searchPathHash;
+
+	void buildPathCache();
+
+	/* Files queued for prefetching are read by a
+	 * background thread into 'prefetched' */
+	PrefetchCache prefetched;
+	std::deque<std::string> prefetchQueue;
+	bool prefetchQuit;
+
+	SDL_mutex *prefetchMut;
+	SDL_cond *prefetchCond;
+	SDL_Thread *prefetchThread;
+
+	/* Print hit counts on exit */
+	bool printPrefetchStats;
+
+	/* Maps: scene name
+	 * To:   files opened while the scene was current,
+	 *       in the order they were first opened */
+	ManifestHash manifests;
+	std::string manifestScene;
+	bool manifestsDirty;
+
+	/* Where to store the recorded manifests, empty if not at all */
+	std::string manifestStore;
+
+	void prefetchFiles();
+
+	/* Null unless tracing is enabled */
+	AccessTrace *trace;
+
+	void traceBegin(AccessTrace::Record &rec, FileSystem::Requester req,
+	                const char *filename, const char *found, uint64_t start)
+	{
+		rec.trace = trace;
+		rec.req = req;
+		rec.via = "";
+		rec.requested = filename;
+		rec.resolved = found;
+		rec.bytes = 0;
+		rec.resolveTime = traceMicros() - start;
+		rec.openTime = 0;
+		rec.readTime = 0;
+	}
+
+	/* Streamed files are recorded on close, with the reads counted */
+	void traceStream(AccessTrace::Record &rec, SDL_RWops &ops,
+	                 const char *via, uint64_t start)
+	{
+		rec.via = via;
+		rec.openTime = traceMicros() - start;
+		ops.hidden.unknown.data2 = new AccessTrace::Record(rec);
+	}
+
+	void joinPathCacheThread()
+	{
+		SDL_LockMutex(pathCacheJoinMut);
+
+		if (pathCacheThread)
+		{
+			SDL_WaitThread(pathCacheThread, 0);
+			pathCacheThread = 0;
+		}
+
+		SDL_UnlockMutex(pathCacheJoinMut);
+	}
+
+	bool lookupPathCache(const std::string &lowCase, std::string &out)
+	{
+		SDL_LockMutex(pathCacheMut);
+		bool found = pathCache && pathCache->find(lowCase, out);
+		bool stored = pathCacheStored;
+		SDL_UnlockMutex(pathCacheMut);
+
+		/* Stored entries are only hints until the build is done */
+		if (found && stored && !PHYSFS_exists(out.c_str()))
+			return false;
+
+		return found;
+	}
+
+	/* Without a path cache, extension completion goes through
+	 * a per directory index instead. Directories are indexed
+	 * the first time something is looked up in them, and the
+	 * whole index is dropped when the search path changes */
+	struct DirIndex
+	{
+		/* Maps: file name and each of its stems (cut off at a '.'),
+		 * To:   full file name */
+		BoostHash<std::string, std::string> exact;
+
+		/* Same with lower case keys, for games that take Windows'
+		 * case insensitivity for granted */
+		BoostHash<std::string, std::string> folded;
+
+		bool find(const char *fname, std::string &out)
+		{
+			if (exact.contains(fname))
+			{
+				out = exact[fname];
+				return true;
+			}
+
+			std::string lowCase(fname);
+
+			for (size_t i = 0; i < lowCase.size(); ++i)
+				lowCase[i] = tolower(lowCase[i]);
+
+			if (folded.contains(lowCase))
+			{
+				out = folded[lowCase];
+				return true;
+			}
+
+			return false;
+		}
+	};
+
+	/* Maps: directory path
+	 * To:   index of its entries */
+	BoostHash<std::string, DirIndex> dirIndex;
+	SDL_mutex *dirIndexMut;
+
+	/* Attempt to locate an extension string in a filename.
+	 * Either a pointer into the input string pointing at the
+	 * extension, or null is returned */
+	const char *findExt(const char *filename)
+	{
+		size_t len;
+
+		for (len = strlen(filename); len > 0; --len)
+		{
+			if (filename[len] == '/')
+				return 0;
+
+			if (filename[len] == '.')
+				return &filename[len+1];
+		}
+
+		return 0;
+	}
+
+	static void dirIndexCB(void *data, const char *,
+	                       const char *fname)
+	{
+		DirIndex &index = *static_cast<DirIndex*>(data);
+
+		std::string name(fname);
+		std::string lowCase(name);
+
+		for (size_t i = 0; i < lowCase.size(); ++i)
+			lowCase[i] = tolower(lowCase[i]);
+
+		/* Earlier entries take precedence, same as
+		 * when the directory was searched in order */
+		index.exact.insert(name, name);
+		index.folded.insert(lowCase, name);
+
+		for (size_t i = name.size(); i > 0; --i)
+		{
+			if (name[i-1] != '.')
+				continue;
+
+			index.exact.insert(name.substr(0, i-1), name);
+			index.folded.insert(lowCase.substr(0, i-1), name);
+		}
+	}
+
+	void buildDirIndex(const std::string &dir, DirIndex &index)
+	{
+		index = DirIndex();
+		PHYSFS_enumerateFilesCallback(dir.c_str(), dirIndexCB, &index);
+	}
+
+	bool lookupDirIndex(const std::string &dir, const char *fname,
+	                    std::string &out)
+	{
+		SDL_LockMutex(dirIndexMut);
+
+		bool fresh = !dirIndex.contains(dir);
+		DirIndex &index = dirIndex[dir];
+
+		if (fresh)
+			buildDirIndex(dir, index);
+
+		bool found = index.find(fname, out);
+
+		/* The file might have been created after the
+		 * directory was indexed, so look once more */
+		if (!found && !fresh)
+		{
+			buildDirIndex(dir, index);
+			found = index.find(fname, out);
+		}
+
+		SDL_UnlockMutex(dirIndexMut);
+
+		return found;
+	}
+
+	void clearDirIndex()
+	{
+		SDL_LockMutex(dirIndexMut);
+		dirIndex = BoostHash<std::string, DirIndex>();
+		SDL_UnlockMutex(dirIndexMut);
+	}
+
+	bool completeFilenameReg(const char *filepath,
+	                         char *outBuffer,
+	                         size_t outN)
+	{
+		strcpySafe(outBuffer, filepath, outN, -1);
+
+		size_t len = strlen(outBuffer);
+		char *delim;
+
+		/* Find the deliminator separating directory and file name */
+		for (delim = outBuffer + len; delim > outBuffer; --delim)
+			if (*delim == '/')
+				break;
+
+		bool root = (delim == outBuffer);
+
+		/* The incomplete file name we're looking for; when found,
+		 * we write the complete file name into this same buffer */
+		char *fname;
+
+		if (!root)
+		{
+			/* If we have such a deliminator, we set it to '\0' so we
+			 * can use the first half as the directory name, and look
+			 * up the second half in its index */
+			fname = delim+1;
+			*delim = '\0';
+		}
+		else
+		{
+			/* Otherwise the file is in the root directory */
+			fname = outBuffer;
+		}
+
+		std::string fullName;
+
+		if (!lookupDirIndex(root ? "" : outBuffer, fname, fullName))
+			return false;
+
+		strcpySafe(fname, fullName.c_str(), outN - (fname - outBuffer),
+		           fullName.size());
+
+		/* Now we put the deliminator back in to form the completed
+		 * file path (if required) */
+		if (!root)
+			*delim = '/';
+
+		return true;
+	}
+
+	bool completeFilenamePC(const char *filepath,
+	                        char *outBuffer,
+	                        size_t outN)
+	{
+		std::string lowCase(filepath);
+
+		for (size_t i = 0; i < lowCase.size(); ++i)
+			lowCase[i] = tolower(lowCase[i]);
+
+		std::string fullPath;
+
+		if (!lookupPathCache(lowCase, fullPath))
+		{
+			/* Either the cache isn't built yet, or the stored
+			 * one we're using is out of date (missing the file,
+			 * or pointing at one that is gone) */
+			joinPathCacheThread();
+
+			if (!lookupPathCache(lowCase, fullPath))
+				return false;
+		}
+
+		strcpySafe(outBuffer, fullPath.c_str(), outN, fullPath.size());
+
+		return true;
+	}
+
+	bool completeFilename(const char *filepath,
+	                      char *outBuffer,
+	                      size_t outN)
+	{
+		if (havePathCache)
+			return completeFilenamePC(filepath, outBuffer, outN);
+		else
+			return completeFilenameReg(filepath, outBuffer, outN);
+	}
+
+	/* Completes 'filename' into 'found' (of size 512),
+	 * and copies its extension into 'extBuf' if provided */
+	void findFile(const char *filename, char *found,
+	              char *extBuf, size_t extBufN)
+	{
+		if (!completeFilename(filename, found, 512))
+			throw Exception(Exception::NoFileError, "%s", filename);
+
+		if (!extBuf)
+			return;
+
+		for (char *q = found+strlen(found); q > found; --q)
+		{
+			if (*q == '/')
+				break;
+
+			if (*q != '.')
+				continue;
+
+			strcpySafe(extBuf, q+1, extBufN, -1);
+			break;
+		}
+	}
+
+	/* Maps 'found' directly if it is a loose file on disk */
+	bool mapLooseFile(const char *found, SDL_RWops &ops)
+	{
+#ifdef __WINDOWS__
+		(void) found;
+		(void) ops;
+
+		return false;
+#else
+		const char *realDir = PHYSFS_getRealDir(found);
+
+		if (!realDir)
+			return false;
+
+		struct stat st;
+
+		/* Files inside archives are read through PhysFS */
+		if (stat(realDir, &st) < 0 || !S_ISDIR(st.st_mode))
+			return false;
+
+		std::string path = std::string(realDir) + "/" + found;
+
+		/* Leave symlinks to PhysFS, which knows whether to follow them */
+		if (lstat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode))
+			return false;
+
+		int fd = open(path.c_str(), O_RDONLY);
+
+		if (fd < 0)
+			return false;
+
+		if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		void *addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		if (addr == MAP_FAILED)
+			return false;
+
+		ops.type = SDL_RWOPS_MAPPED;
+		ops.hidden.mem.base = ops.hidden.mem.here = static_cast<Uint8*>(addr);
+		ops.hidden.mem.stop = ops.hidden.mem.base + st.st_size;
+
+		return true;
+#endif
+	}
+
+	/* Reads (and thereby decrypts) all of 'found' into a buffer */
+	void readWholeFile(const char *found, SDL_RWops &ops)
+	{
+		PHYSFS_File *handle = PHYSFS_openRead(found);
+
+		if (!handle)
+			throw Exception(Exception::PHYSFSError, "PhysFS: %s", PHYSFS_getLastError());
+
+		PHYSFS_sint64 length = PHYSFS_fileLength(handle);
+
+		/* Allocate at least one byte so the view is never null */
+		Uint8 *buffer = static_cast<Uint8*>(malloc(std::max<PHYSFS_sint64>(length, 1)));
+
+		if (!buffer)
+		{
+			PHYSFS_close(handle);
+			throw Exception(Exception::MKXPError, "Out of memory reading '%s'", found);
+		}
+
+		PHYSFS_sint64 read = length > 0 ? PHYSFS_readBytes(handle, buffer, length) : 0;
+		PHYSFS_close(handle);
+
+		if (read < length)
+		{
+			free(buffer);
+			throw Exception(Exception::PHYSFSError, "PhysFS: %s", PHYSFS_getLastError());
+		}
+
+		ops.type = SDL_RWOPS_BUFFER;
+		ops.hidden.mem.base = ops.hidden.mem.here = buffer;
+		ops.hidden.mem.stop = buffer + std::max<PHYSFS_sint64>(length, 0);
+	}
+
+	/* Hands over 'found' from the prefetch cache if it's there */
+	bool takePrefetched(const char *found, SDL_RWops &ops)
+	{
+		Uint8 *data;
+		size_t size;
+
+		SDL_LockMutex(prefetchMut);
+		bool have = prefetched.take(found, data, size);
+		SDL_UnlockMutex(prefetchMut);
+
+		if (!have)
+			return false;
+
+		ops.type = SDL_RWOPS_BUFFER;
+		ops.hidden.mem.base = ops.hidden.mem.here = data;
+		ops.hidden.mem.stop = data + size;
+
+		return true;
+	}
+
+	/* Adds 'found' to the manifest of the current scene */
+	void recordOpen(const char *found)
+	{
+		SDL_LockMutex(prefetchMut);
+
+		if (!manifestScene.empty())
+		{
+			std::vector<std::string> &files = manifests[manifestScene];
+
+			if (files.size() < PREFETCH_MANIFEST_MAX
+			    && std::find(files.begin(), files.end(), found) == files.end())
+			{
+				files.push_back(found);
+				manifestsDirty = true;
+			}
+		}
+
+		SDL_UnlockMutex(prefetchMut);
+	}
+
+	void initMemOps(SDL_RWops &ops,
+	                bool freeOnClose)
+	{
+		ops.size  = SDL_RWopsMemSize;
+		ops.seek  = SDL_RWopsMemSeek;
+		ops.read  = SDL_RWopsMemRead;
+		ops.write = SDL_RWopsMemWrite;
+
+		if (freeOnClose)
+			ops.close = SDL_RWopsMemCloseFree;
+		else
+			ops.close = SDL_RWopsMemClose;
+	}
+
+	void initReadOps(PHYSFS_File *handle,
+	                 SDL_RWops &ops,
+	                 bool freeOnClose)
+	{
+		ops.size  = SDL_RWopsSize;
+		ops.seek  = SDL_RWopsSeek;
+		ops.read  = SDL_RWopsRead;
+		ops.write = SDL_RWopsWrite;
+
+		if (freeOnClose)
+			ops.close = SDL_RWopsCloseFree;
+		else
+			ops.close = SDL_RWopsClose;
+
+		ops.type = SDL_RWOPS_PHYSFS;
+		ops.hidden.unknown.data1 = handle;
+		ops.hidden.unknown.data2 = 0;
+	}
+};
+
+FileSystem::FileSystem(const char *argv0,
+                       bool allowSymlinks,
+                       bool mmapArchives,
+                       const char *indexCacheDir)
+{
+	p = new FileSystemPrivate;
+	p->pathCache = 0;
+	p->havePathCache = false;
+	p->pathCacheStored = false;
+	p->pathCacheMut = SDL_CreateMutex();
+	p->pathCacheThread = 0;
+	p->pathCacheJoinMut = SDL_CreateMutex();
+	p->searchPathHash = 0;
+	p->dirIndexMut = SDL_CreateMutex();
+	p->prefetchQuit = false;
+	p->prefetchMut = SDL_CreateMutex();
+	p->prefetchCond = SDL_CreateCond();
+	p->prefetchThread = 0;
+	p->printPrefetchStats = false;
+	p->manifestsDirty = false;
+	p->trace = 0;
+
+	PHYSFS_init(argv0);
+
+	PHYSFS_registerArchiver(&RGSS1_Archiver);
+	PHYSFS_registerArchiver(&RGSS2_Archiver);
+	PHYSFS_registerArchiver(&RGSS3_Archiver);
+
+	RGSS_setMapArchives(mmapArchives);
+	RGSS_setIndexCacheDir(indexCacheDir);
+
+	if (allowSymlinks)
+		PHYSFS_permitSymbolicLinks(1);
+}
+
+FileSystem::~FileSystem()
+{
+	p->joinPathCacheThread();
+
+	if (p->prefetchThread)
+	{
+		SDL_LockMutex(p->prefetchMut);
+		p->prefetchQuit = true;
+		SDL_CondSignal(p->prefetchCond);
+		SDL_UnlockMutex(p->prefetchMut);
+
+		SDL_WaitThread(p->prefetchThread, 0);
+
+		if (p->printPrefetchStats)
+			Debug() << "Prefetch:" << p->prefetched.hits << "files used,"
+			        << p->prefetched.unused << "dropped unused";
+	}
+
+	if (p->manifestsDirty && !p->manifestStore.empty())
+		storeManifests(p->manifestStore.c_str(), p->manifests);
+
+	delete p->trace;
+
+	delete p->pathCache;
+	SDL_DestroyMutex(p->pathCacheMut);
+	SDL_DestroyMutex(p->pathCacheJoinMut);
+	SDL_DestroyMutex(p->dirIndexMut);
+	SDL_DestroyMutex(p->prefetchMut);
+	SDL_DestroyCond(p->prefetchCond);
+	delete p;
 
 	if (PHYSFS_deinit() == 0)
 		Debug() << "PhyFS failed to deinit.";
@@ -482,25 +1497,41 @@ void FileSystem::addPath(const char *path)
 		if (io)
 			PHYSFS_mountIo(io, path, 0, 1);
 	}
+
+	p->clearDirIndex();
 }
 
-#ifdef __APPLE__
 struct CacheEnumCBData
 {
-	FileSystemPrivate *p;
+	PathCacheTable *table;
+
+	/* Entries of the directory being enumerated, and entries
+	 * still to be enumerated themselves. PhysFS holds its state
+	 * lock throughout an enumeration, so we don't recurse from
+	 * within the callback and keep other threads waiting */
+	std::vector<std::string> children;
+	std::vector<std::string> pending;
+
+#ifdef __APPLE__
 	iconv_t nfd2nfc;
+#endif
 
-	CacheEnumCBData(FileSystemPrivate *fsp)
+	CacheEnumCBData(PathCacheTable *table)
+	    : table(table)
 	{
-		p = fsp;
+#ifdef __APPLE__
 		nfd2nfc = iconv_open("utf-8", "utf-8-mac");
+#endif
 	}
 
 	~CacheEnumCBData()
 	{
+#ifdef __APPLE__
 		iconv_close(nfd2nfc);
+#endif
 	}
 
+#ifdef __APPLE__
 	void nfcFromNfd(char *dst, const char *src, size_t dstSize)
 	{
 		size_t srcSize = strlen(src);
@@ -514,18 +1545,13 @@ struct CacheEnumCBData
 		/* Null-terminate */
 		*dst = 0;
 	}
-};
 #endif
+};
 
 static void cacheEnumCB(void *d, const char *origdir,
                         const char *fname)
 {
-#ifdef __APPLE__
 	CacheEnumCBData *data = static_cast<CacheEnumCBData*>(d);
-	FileSystemPrivate *p = data->p;
-#else
-	FileSystemPrivate *p = static_cast<FileSystemPrivate*>(d);
-#endif
 
 	char buf[512];
 
@@ -547,44 +1573,377 @@ static void cacheEnumCB(void *d, const char *origdir,
 	if (*ptr == '/')
 		++ptr;
 
-	std::string mixedCase(ptr);
+	data->table->insert(ptr);
+	data->children.push_back(ptr);
+}
+
+void FileSystemPrivate::buildPathCache()
+{
+	PathCacheTable *table = new PathCacheTable;
+
+	{
+		CacheEnumCBData data(table);
+		data.pending.push_back("");
+
+		while (!data.pending.empty())
+		{
+			std::string dir = data.pending.back();
+			data.pending.pop_back();
+
+			PHYSFS_enumerateFilesCallback(dir.c_str(), cacheEnumCB, &data);
+
+			/* Visit the entries in order, depth first */
+			data.pending.insert(data.pending.end(),
+			                    data.children.rbegin(), data.children.rend());
+			data.children.clear();
+		}
+	}
+
+	SDL_LockMutex(pathCacheMut);
+	PathCacheTable *old = pathCache;
+	pathCache = table;
+	pathCacheStored = false;
+	SDL_UnlockMutex(pathCacheMut);
+
+	if (!pathCacheStore.empty() && !(old && *old == *table))
+		table->store(pathCacheStore.c_str(), searchPathHash);
+
+	delete old;
+}
+
+/* Files stored between runs are keyed by the search path */
+static uint32_t searchPathHash()
+{
+	std::string searchPath;
+	char **list = PHYSFS_getSearchPath();
+
+	for (char **i = list; *i; ++i)
+		(searchPath += *i) += '\n';
+
+	PHYSFS_freeList(list);
+
+	return fnv1a(searchPath.c_str(), searchPath.size());
+}
+
+void FileSystem::createPathCache(const char *storeDir)
+{
+	if (storeDir && *storeDir)
+	{
+		p->searchPathHash = searchPathHash();
+		char file[32];
+		snprintf(file, sizeof(file), "pathcache-%08x.mkxp", p->searchPathHash);
+		p->pathCacheStore = std::string(storeDir) + file;
+
+		PathCacheTable *stored = new PathCacheTable;
+
+		if (stored->load(p->pathCacheStore.c_str(), p->searchPathHash))
+		{
+			p->pathCache = stored;
+			p->pathCacheStored = true;
+		}
+		else
+			delete stored;
+	}
 
-	for (char *q = bufNfc; *q; ++q)
-		*q = tolower(*q);
+	p->havePathCache = true;
+	p->pathCacheThread =
+	        createSDLThread<FileSystemPrivate, &FileSystemPrivate::buildPathCache>
+	            (p, "pathcache");
+}
 
-	p->pathCache.insert(std::string(ptr), mixedCase);
+void FileSystemPrivate::prefetchFiles()
+{
+	SDL_LockMutex(prefetchMut);
 
-	for (char *q = ptr+strlen(ptr); q > ptr; --q)
+	while (true)
 	{
-		if (*q == '/')
+		while (prefetchQueue.empty() && !prefetchQuit)
+			SDL_CondWait(prefetchCond, prefetchMut);
+
+		if (prefetchQuit)
 			break;
 
-		if (*q != '.')
-			continue;
+		std::string filename = prefetchQueue.front();
+		prefetchQueue.pop_front();
+
+		SDL_UnlockMutex(prefetchMut);
+
+		char found[512];
+		SDL_RWops ops;
+		bool have = false;
+
+		try
+		{
+			findFile(filename.c_str(), found, 0, 0);
 
-		*q = '\0';
-		p->pathCache.insert(std::string(ptr), mixedCase);
+			SDL_LockMutex(prefetchMut);
+			bool cached = prefetched.contains(found);
+			SDL_UnlockMutex(prefetchMut);
+
+			if (!cached)
+			{
+				readWholeFile(found, ops);
+				have = true;
+			}
+		}
+		catch (const Exception &e)
+		{
+			/* Whoever opens the file will get to see this */
+			Debug() << "Prefetch:" << e.msg;
+		}
+
+		SDL_LockMutex(prefetchMut);
+
+		if (have)
+			prefetched.put(found, ops.hidden.mem.base,
+			               ops.hidden.mem.stop - ops.hidden.mem.base);
 	}
 
-	PHYSFS_enumerateFilesCallback(mixedCase.c_str(), cacheEnumCB, d);
+	SDL_UnlockMutex(prefetchMut);
 }
 
-void FileSystem::createPathCache()
+void FileSystem::initPrefetch(size_t cacheSize, const char *manifestDir,
+                              bool printStats)
 {
-#ifdef __APPLE__
-	CacheEnumCBData data(p);
-	PHYSFS_enumerateFilesCallback("", cacheEnumCB, &data);
-#else
-	PHYSFS_enumerateFilesCallback("", cacheEnumCB, p);
-#endif
+	if (cacheSize == 0)
+		return;
 
-	p->havePathCache = true;
+	p->prefetched.budget = cacheSize;
+	p->printPrefetchStats = printStats;
+
+	if (manifestDir && *manifestDir)
+	{
+		char file[32];
+		snprintf(file, sizeof(file), "prefetch-%08x.mkxp", searchPathHash());
+		p->manifestStore = std::string(manifestDir) + file;
+
+		loadManifests(p->manifestStore.c_str(), p->manifests);
+	}
+
+	p->prefetchThread =
+	        createSDLThread<FileSystemPrivate, &FileSystemPrivate::prefetchFiles>
+	            (p, "prefetch");
+}
+
+void FileSystem::prefetch(const char *filename)
+{
+	if (!p->prefetchThread)
+		return;
+
+	SDL_LockMutex(p->prefetchMut);
+	p->prefetchQueue.push_back(filename);
+	SDL_CondSignal(p->prefetchCond);
+	SDL_UnlockMutex(p->prefetchMut);
+}
+
+void FileSystem::prefetchScene(const char *scene)
+{
+	if (!p->prefetchThread)
+		return;
+
+	/* Scene names have to fit on one line of the stored manifest */
+	std::string name(scene);
+	std::replace(name.begin(), name.end(), '\n', ' ');
+
+	SDL_LockMutex(p->prefetchMut);
+
+	p->manifestScene = name;
+
+	if (p->manifests.contains(name))
+	{
+		const std::vector<std::string> &files = p->manifests[name];
+		p->prefetchQueue.insert(p->prefetchQueue.end(), files.begin(), files.end());
+		SDL_CondSignal(p->prefetchCond);
+	}
+
+	SDL_UnlockMutex(p->prefetchMut);
+}
+
+/* Names of the fonts found last time, so they don't have
+ * to be read from the font files again on every launch */
+struct FontIndexEntry
+{
+	uint64_t size;
+	int64_t mtime;
+	/* False for files that turned out not to be usable fonts */
+	bool valid;
+	std::string family;
+	std::string style;
+
+	bool operator==(const FontIndexEntry &o) const
+	{
+		return size == o.size && mtime == o.mtime && valid == o.valid
+		    && family == o.family && style == o.style;
+	}
+};
+
+typedef BoostHash<std::string, FontIndexEntry> FontIndex;
+
+#define FONT_INDEX_MAGIC "MKXPFI"
+#define FONT_INDEX_VER 1
+
+struct FontIndexHeader
+{
+	char magic[8];
+	uint32_t formVer;
+	uint32_t count;
+};
+
+static void writeIndexString(std::vector<char> &out, const std::string &str)
+{
+	uint32_t len = str.size();
+	out.insert(out.end(), (const char*) &len, (const char*) &len + sizeof(len));
+	out.insert(out.end(), str.begin(), str.end());
+}
+
+static bool readIndexString(const std::vector<char> &in, size_t &pos, std::string &str)
+{
+	uint32_t len;
+
+	if (in.size() - pos < sizeof(len))
+		return false;
+
+	memcpy(&len, &in[pos], sizeof(len));
+	pos += sizeof(len);
+
+	if (in.size() - pos < len)
+		return false;
+
+	str.assign(in.begin() + pos, in.begin() + pos + len);
+	pos += len;
+
+	return true;
+}
+
+static bool readFontIndex(const std::string &path, FontIndex &index)
+{
+	std::vector<char> in;
+	FILE *f = fopen(path.c_str(), "rb");
+
+	if (!f)
+		return false;
+
+	char buf[4096];
+	size_t n;
+
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		in.insert(in.end(), buf, buf+n);
+
+	fclose(f);
+
+	FontIndexHeader hd;
+
+	if (in.size() < sizeof(hd))
+		return false;
+
+	memcpy(&hd, &in[0], sizeof(hd));
+
+	if (memcmp(hd.magic, FONT_INDEX_MAGIC, sizeof(FONT_INDEX_MAGIC))
+	    || hd.formVer != FONT_INDEX_VER)
+		return false;
+
+	size_t pos = sizeof(hd);
+
+	for (uint32_t i = 0; i < hd.count; ++i)
+	{
+		FontIndexEntry entry;
+		std::string filename;
+		const size_t fixedSize = sizeof(entry.size) + sizeof(entry.mtime) + 1;
+
+		if (in.size() - pos < fixedSize)
+			return false;
+
+		memcpy(&entry.size, &in[pos], sizeof(entry.size));
+		pos += sizeof(entry.size);
+		memcpy(&entry.mtime, &in[pos], sizeof(entry.mtime));
+		pos += sizeof(entry.mtime);
+		entry.valid = in[pos++] != 0;
+
+		if (!readIndexString(in, pos, filename)
+		    || !readIndexString(in, pos, entry.family)
+		    || !readIndexString(in, pos, entry.style))
+			return false;
+
+		index.insert(filename, entry);
+	}
+
+	return true;
+}
+
+static void writeFontIndex(const std::string &path, const FontIndex &index)
+{
+	std::vector<char> out(sizeof(FontIndexHeader));
+
+	FontIndexHeader hd;
+	memset(&hd, 0, sizeof(hd));
+	memcpy(hd.magic, FONT_INDEX_MAGIC, sizeof(FONT_INDEX_MAGIC));
+	hd.formVer = FONT_INDEX_VER;
+	hd.count = 0;
+
+	FontIndex::const_iterator iter;
+	for (iter = index.cbegin(); iter != index.cend(); ++iter)
+	{
+		const FontIndexEntry &entry = iter->second;
+
+		out.insert(out.end(), (const char*) &entry.size,
+		           (const char*) &entry.size + sizeof(entry.size));
+		out.insert(out.end(), (const char*) &entry.mtime,
+		           (const char*) &entry.mtime + sizeof(entry.mtime));
+		out.push_back(entry.valid ? 1 : 0);
+
+		writeIndexString(out, iter->first);
+		writeIndexString(out, entry.family);
+		writeIndexString(out, entry.style);
+
+		++hd.count;
+	}
+
+	memcpy(&out[0], &hd, sizeof(hd));
+
+	FILE *f = fopen(path.c_str(), "wb");
+
+	if (!f)
+		return;
+
+	bool ok = fwrite(&out[0], 1, out.size(), f) == out.size();
+	fclose(f);
+
+	if (!ok)
+		remove(path.c_str());
+}
+
+/* Size and modification time identify a font file. Files
+ * inside archives carry no time of their own, so the
+ * archive's is used instead */
+static bool fontFileKey(const char *filename, FontIndexEntry &entry)
+{
+	PHYSFS_Stat st;
+
+	if (!PHYSFS_stat(filename, &st))
+		return false;
+
+	entry.size = st.filesize;
+	entry.mtime = st.modtime;
+
+	if (entry.mtime <= 0)
+	{
+		const char *realDir = PHYSFS_getRealDir(filename);
+		struct stat hostSt;
+
+		if (realDir && stat(realDir, &hostSt) == 0)
+			entry.mtime = hostSt.st_mtime;
+	}
+
+	return true;
 }
 
 struct FontSetsCBData
 {
 	FileSystemPrivate *p;
 	SharedFontState *sfs;
+
+	FontIndex stored;
+	FontIndex current;
 };
 
 static void fontSetEnumCB(void *data, const char *,
@@ -612,6 +1971,23 @@ static void fontSetEnumCB(void *data, const char *,
 	char filename[512];
 	snprintf(filename, sizeof(filename), "Fonts/%s", fname);
 
+	FontIndexEntry entry;
+	bool haveKey = fontFileKey(filename, entry);
+
+	if (haveKey && d->stored.contains(filename))
+	{
+		const FontIndexEntry &stored = d->stored[filename];
+
+		if (stored.size == entry.size && stored.mtime == entry.mtime)
+		{
+			if (stored.valid)
+				d->sfs->addFontSet(stored.family, stored.style, filename);
+
+			d->current.insert(filename, stored);
+			return;
+		}
+	}
+
 	PHYSFS_File *handle = PHYSFS_openRead(filename);
 
 	if (!handle)
@@ -620,37 +1996,185 @@ static void fontSetEnumCB(void *data, const char *,
 	SDL_RWops ops;
 	p->initReadOps(handle, ops, false);
 
-	d->sfs->initFontSetCB(ops, filename);
+	entry.valid = d->sfs->initFontSetCB(ops, filename, entry.family, entry.style);
 
 	SDL_RWclose(&ops);
+
+	if (haveKey)
+		d->current.insert(filename, entry);
 }
 
-void FileSystem::initFontSets(SharedFontState &sfs)
+void FileSystem::initFontSets(SharedFontState &sfs, const char *indexDir)
 {
-	FontSetsCBData d = { p, &sfs };
+	FontSetsCBData d;
+	d.p = p;
+	d.sfs = &sfs;
+
+	std::string indexPath;
+
+	if (indexDir && *indexDir)
+	{
+		char file[32];
+		snprintf(file, sizeof(file), "fontindex-%08x.mkxp", searchPathHash());
+		indexPath = std::string(indexDir) + file;
+
+		readFontIndex(indexPath, d.stored);
+	}
 
 	PHYSFS_enumerateFilesCallback("Fonts", fontSetEnumCB, &d);
+
+	if (indexPath.empty())
+		return;
+
+	/* Only write the index back if anything changed */
+	bool changed = false;
+	size_t storedCount = 0;
+
+	FontIndex::const_iterator iter;
+	for (iter = d.stored.cbegin(); iter != d.stored.cend(); ++iter)
+		++storedCount;
+
+	size_t currentCount = 0;
+
+	for (iter = d.current.cbegin(); iter != d.current.cend() && !changed; ++iter)
+	{
+		++currentCount;
+		changed = !d.stored.contains(iter->first)
+		       || !(d.stored[iter->first] == iter->second);
+	}
+
+	if (changed || currentCount != storedCount)
+		writeFontIndex(indexPath, d.current);
+}
+
+void FileSystem::initAccessTrace(const char *logDir)
+{
+	std::string logPath;
+
+	if (logDir && *logDir)
+		logPath = std::string(logDir) + "asset-trace.log";
+
+	p->trace = new AccessTrace(logPath.empty() ? 0 : logPath.c_str());
 }
 
 void FileSystem::openRead(SDL_RWops &ops,
                           const char *filename,
                           bool freeOnClose,
                           char *extBuf,
-                          size_t extBufN)
+                          size_t extBufN,
+                          Requester req)
 {
- 	PHYSFS_File *handle = p->openReadHandle(filename, extBuf, extBufN);
+	uint64_t start = p->trace ? traceMicros() : 0;
+
+	char found[512];
+	p->findFile(filename, found, extBuf, extBufN);
+	p->recordOpen(found);
+
+	AccessTrace::Record rec;
+
+	if (p->trace)
+	{
+		p->traceBegin(rec, req, filename, found, start);
+		start = traceMicros();
+	}
+
+	if (p->takePrefetched(found, ops))
+	{
+		p->initMemOps(ops, freeOnClose);
+
+		if (p->trace)
+		{
+			rec.via = "prefetched";
+			rec.bytes = SDL_RWopsMemSize(&ops);
+			rec.openTime = traceMicros() - start;
+			p->trace->add(rec);
+		}
+
+		return;
+	}
+
+	PHYSFS_File *handle = PHYSFS_openRead(found);
+
+	if (!handle)
+		throw Exception(Exception::PHYSFSError, "PhysFS: %s", PHYSFS_getLastError());
 
 	p->initReadOps(handle, ops, freeOnClose);
+
+	if (p->trace)
+		p->traceStream(rec, ops, "stream", start);
+}
+
+void FileSystem::openReadMapped(SDL_RWops &ops,
+                                const char *filename,
+                                bool freeOnClose,
+                                char *extBuf,
+                                size_t extBufN,
+                                Requester req)
+{
+	uint64_t start = p->trace ? traceMicros() : 0;
+
+	char found[512];
+	p->findFile(filename, found, extBuf, extBufN);
+	p->recordOpen(found);
+
+	AccessTrace::Record rec;
+
+	if (p->trace)
+	{
+		p->traceBegin(rec, req, filename, found, start);
+		start = traceMicros();
+	}
+
+	const char *via;
+
+	if (p->takePrefetched(found, ops))
+		via = "prefetched";
+	else if (p->mapLooseFile(found, ops))
+		via = "mapped";
+	else
+		via = 0;
+
+	if (p->trace)
+		rec.openTime = traceMicros() - start;
+
+	if (!via)
+	{
+		p->readWholeFile(found, ops);
+		via = "buffered";
+
+		if (p->trace)
+			rec.readTime = traceMicros() - start - rec.openTime;
+	}
+
+	p->initMemOps(ops, freeOnClose);
+
+	if (p->trace)
+	{
+		rec.via = via;
+		rec.bytes = SDL_RWopsMemSize(&ops);
+		p->trace->add(rec);
+	}
 }
 
 void FileSystem::openReadRaw(SDL_RWops &ops,
                              const char *filename,
-                             bool freeOnClose)
+                             bool freeOnClose,
+                             Requester req)
 {
+	uint64_t start = p->trace ? traceMicros() : 0;
+
 	PHYSFS_File *handle = PHYSFS_openRead(filename);
 	assert(handle);
 
 	p->initReadOps(handle, ops, freeOnClose);
+
+	if (p->trace)
+	{
+		AccessTrace::Record rec;
+		p->traceBegin(rec, req, filename, filename, start);
+		rec.resolveTime = 0;
+		p->traceStream(rec, ops, "raw", start);
+	}
 }
 
 bool FileSystem::exists(const char *filename)
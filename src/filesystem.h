@@ -31,28 +31,78 @@ class FileSystem
 {
 public:
 	FileSystem(const char *argv0,
-	           bool allowSymlinks);
+	           bool allowSymlinks,
+	           bool mmapArchives,
+	           const char *indexCacheDir);
 	~FileSystem();
 
+	/* What an asset is opened for, as shown in the access trace */
+	enum Requester
+	{
+		ReqOther,
+		ReqBitmap,
+		ReqAudio,
+		ReqData,
+		ReqFont
+	};
+
+	/* Records every asset opened from now on, and reports
+	 * the most expensive and most often opened files on exit.
+	 * If 'logDir' is given, each open is also logged there */
+	void initAccessTrace(const char *logDir = 0);
+
 	void addPath(const char *path);
 
-	/* Call these after the last 'addPath()' */
-	void createPathCache();
+	/* Call these after the last 'addPath()'.
+	 * If 'storeDir' is given, the cache is stored there
+	 * and reused on the next run until the new one is built */
+	void createPathCache(const char *storeDir = 0);
 
 	/* Scans "Fonts/" and creates inventory of
-	 * available font assets */
-	void initFontSets(SharedFontState &sfs);
+	 * available font assets. If 'indexDir' is given,
+	 * the font names found are kept there and only
+	 * re-read from font files that changed */
+	void initFontSets(SharedFontState &sfs,
+	                  const char *indexDir = 0);
+
+	/* Enables prefetching: queued files are read (and decrypted)
+	 * on a background thread into a memory cache of at most
+	 * 'cacheSize' bytes, and handed over on their next open.
+	 * If 'manifestDir' is given, the files opened per scene
+	 * are kept there for 'prefetchScene()' on later runs */
+	void initPrefetch(size_t cacheSize, const char *manifestDir = 0,
+	                  bool printStats = false);
+
+	/* Queues 'filename' for prefetching */
+	void prefetch(const char *filename);
+
+	/* Queues the files opened during the last visit of 'scene',
+	 * and records the ones opened from now on under its name */
+	void prefetchScene(const char *scene);
 
 	void openRead(SDL_RWops &ops,
 	              const char *filename,
 	              bool freeOnClose = false,
 	              char *extBuf = 0,
-	              size_t extBufN = 0);
+	              size_t extBufN = 0,
+	              Requester req = ReqOther);
+
+	/* Same as 'openRead()', but the whole file is made available
+	 * as one contiguous, already decrypted block of memory (loose
+	 * files are mapped, archive entries read in one go). Meant for
+	 * assets that are consumed fully right after opening */
+	void openReadMapped(SDL_RWops &ops,
+	                    const char *filename,
+	                    bool freeOnClose = false,
+	                    char *extBuf = 0,
+	                    size_t extBufN = 0,
+	                    Requester req = ReqOther);
 
 	/* Circumvents extension supplementing */
 	void openReadRaw(SDL_RWops &ops,
 	                 const char *filename,
-	                 bool freeOnClose = false);
+	                 bool freeOnClose = false,
+	                 Requester req = ReqOther);
 
 	bool exists(const char *filename);
 
@@ -45,6 +45,8 @@ public:
 		this->duration = duration;
 		counter = 0;
 
+		onFlashChange();
+
 		if (!color)
 		{
 			emptyFlashFlag = true;
@@ -60,6 +62,8 @@ public:
 		if (!flashing)
 			return;
 
+		onFlashChange();
+
 		if (++counter > duration)
 		{
 			/* Flash finished. Cleanup */
@@ -78,6 +82,9 @@ public:
 	}
 
 protected:
+	/* Called whenever the flash state visibly changes */
+	virtual void onFlashChange() {}
+
 	Vec4 flashColor;
 	bool flashing;
 	bool emptyFlashFlag;
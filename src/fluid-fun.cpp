@@ -28,11 +28,12 @@ void initFluidFunctions()
 {
 #ifdef SHARED_FLUID
 
+/* Signatures differ slightly between fluidsynth versions */
 #define FLUID_FUN(name, type) \
-	fluid.name = fluid_##name;
+	fluid.name = (type) fluid_##name;
 
 #define FLUID_FUN2(name, type, real_name) \
-	fluid.name = real_name;
+	fluid.name = (type) real_name;
 
 #else
 	so = SDL_LoadObject(FLUID_LIB);
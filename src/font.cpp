@@ -30,6 +30,8 @@
 
 #include <string>
 #include <utility>
+#include <vector>
+#include <stdint.h>
 
 #include <SDL_ttf.h>
 
@@ -108,19 +110,263 @@ SharedFontState::~SharedFontState()
 	delete p;
 }
 
-void SharedFontState::initFontSetCB(SDL_RWops &ops,
-                                    const std::string &filename)
+static uint16_t readBE16(const uint8_t *p)
 {
-	TTF_Font *font = TTF_OpenFontRW(&ops, 0, 0);
+	return (p[0] << 8) | p[1];
+}
 
-	if (!font)
-		return;
+static uint32_t readBE32(const uint8_t *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static bool readAt(SDL_RWops &ops, Sint64 offset, void *dst, size_t size)
+{
+	if (SDL_RWseek(&ops, offset, RW_SEEK_SET) != offset)
+		return false;
+
+	return SDL_RWread(&ops, dst, 1, size) == size;
+}
+
+#define SFNT_TAG_TTCF 0x74746366 /* 'ttcf' */
+#define SFNT_TAG_NAME 0x6E616D65 /* 'name' */
+#define SFNT_TAG_OS2  0x4F532F32 /* 'OS/2' */
+
+/* OS/2 fsSelection bit: the family and subfamily
+ * names are WWS conformant already */
+#define OS2_FS_WWS (1 << 8)
+
+/* Picks the record for 'nameID' out of a 'name' table and
+ * converts it to ASCII, following FreeType's tt_face_get_name()
+ * so we end up with the same names SDL_ttf would report */
+static bool sfntName(const std::vector<uint8_t> &table,
+                     uint16_t nameID, std::string &out)
+{
+	if (table.size() < 6)
+		return false;
+
+	const uint8_t *t = &table[0];
+	uint16_t count = readBE16(t+2);
+	uint16_t strOffset = readBE16(t+4);
+
+	if (6 + count*12 > table.size())
+		return false;
+
+	int foundUnicode = -1, foundAppleEnglish = -1, foundAppleRoman = -1;
+	int foundWin = -1;
+	bool isEnglish = false;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const uint8_t *rec = t + 6 + i*12;
+
+		if (readBE16(rec+6) != nameID || readBE16(rec+8) == 0)
+			continue;
+
+		uint16_t platform = readBE16(rec);
+		uint16_t encoding = readBE16(rec+2);
+		uint16_t language = readBE16(rec+4);
+
+		switch (platform)
+		{
+		case 0 : /* Apple Unicode */
+		case 2 : /* ISO */
+			foundUnicode = i;
+			break;
+
+		case 1 : /* Macintosh */
+			if (language == 0)
+				foundAppleEnglish = i;
+			else if (encoding == 0)
+				foundAppleRoman = i;
+			break;
+
+		case 3 : /* Microsoft */
+			if (foundWin != -1 && (language & 0x3FF) != 0x009)
+				break;
+
+			/* Symbol, Unicode BMP, full Unicode */
+			if (encoding == 0 || encoding == 1 || encoding == 10)
+			{
+				isEnglish = (language & 0x3FF) == 0x009;
+				foundWin = i;
+			}
+		}
+	}
+
+	int foundApple = foundAppleEnglish >= 0 ? foundAppleEnglish : foundAppleRoman;
+	int found;
+	bool utf16;
+
+	if (foundWin >= 0 && !(foundApple >= 0 && !isEnglish))
+	{
+		found = foundWin;
+		utf16 = true;
+	}
+	else if (foundApple >= 0)
+	{
+		found = foundApple;
+		utf16 = false;
+	}
+	else if (foundUnicode >= 0)
+	{
+		found = foundUnicode;
+		utf16 = true;
+	}
+	else
+	{
+		return false;
+	}
+
+	const uint8_t *rec = t + 6 + found*12;
+	size_t length = readBE16(rec+8);
+	size_t offset = strOffset + readBE16(rec+10);
+
+	if (offset + length > table.size())
+		return false;
+
+	const uint8_t *str = t + offset;
+	size_t charSize = utf16 ? 2 : 1;
+
+	out.clear();
+
+	for (size_t i = 0; i + charSize <= length; i += charSize)
+	{
+		uint16_t code = utf16 ? readBE16(str+i) : str[i];
+
+		if (code == 0)
+			break;
+
+		if (code < 32 || code > 127)
+			code = '?';
+
+		out += (char) code;
+	}
+
+	return true;
+}
+
+/* Reads family and style name straight out of the 'name'
+ * table of a TrueType / OpenType font (or the first face of
+ * a collection), without loading the face itself */
+static bool readSfntNames(SDL_RWops &ops,
+                          std::string &family, std::string &style)
+{
+	uint8_t header[12];
 
-	std::string family = TTF_FontFaceFamilyName(font);
-	std::string style = TTF_FontFaceStyleName(font);
+	if (!readAt(ops, 0, header, sizeof(header)))
+		return false;
 
-	TTF_CloseFont(font);
+	if (readBE32(header) == SFNT_TAG_TTCF)
+	{
+		uint8_t firstFace[4];
+
+		if (!readAt(ops, 12, firstFace, sizeof(firstFace))
+		    || !readAt(ops, readBE32(firstFace), header, sizeof(header)))
+			return false;
+	}
+
+	uint16_t numTables = readBE16(header+4);
+	Sint64 dirOffset = SDL_RWtell(&ops);
+
+	if (numTables == 0)
+		return false;
+
+	std::vector<uint8_t> dir(numTables * 16);
+
+	if (!readAt(ops, dirOffset, &dir[0], dir.size()))
+		return false;
+
+	const uint8_t *nameRec = 0;
+	uint16_t fsSelection = 0;
+
+	for (uint16_t i = 0; i < numTables; ++i)
+	{
+		const uint8_t *rec = &dir[i*16];
+
+		if (readBE32(rec) == SFNT_TAG_NAME)
+			nameRec = rec;
+
+		/* fsSelection is at the same offset in all OS/2 versions */
+		uint8_t fsSel[2];
+
+		if (readBE32(rec) == SFNT_TAG_OS2 && readBE32(rec+12) >= 64
+		    && readAt(ops, (Sint64) readBE32(rec+8) + 62, fsSel, sizeof(fsSel)))
+			fsSelection = readBE16(fsSel);
+	}
+
+	if (!nameRec)
+		return false;
+
+	uint32_t offset = readBE32(nameRec+8);
+	uint32_t length = readBE32(nameRec+12);
+
+	/* Name tables are small; anything bigger is bogus */
+	if (length < 6 || length > (1 << 20))
+		return false;
 
+	std::vector<uint8_t> table(length);
+
+	if (!readAt(ops, offset, &table[0], length))
+		return false;
+
+	/* Same precedence as FreeType's sfnt_load_face(): the WWS names
+	 * (21/22) come first, unless the OS/2 table says the regular
+	 * ones are WWS conformant, then the typographic ones (16/17) */
+	bool wws = !(fsSelection & OS2_FS_WWS);
+
+	if (!(wws && sfntName(table, 21, family))
+	    && !sfntName(table, 16, family) && !sfntName(table, 1, family))
+		return false;
+
+	if (!(wws && sfntName(table, 22, style))
+	    && !sfntName(table, 17, style) && !sfntName(table, 2, style))
+		return false;
+
+	return true;
+}
+
+bool SharedFontState::initFontSetCB(SDL_RWops &ops,
+                                    const std::string &filename,
+                                    std::string &family,
+                                    std::string &style)
+{
+	if (!readSfntNames(ops, family, style))
+	{
+		/* Not something we can parse ourselves;
+		 * let FreeType have a go at it */
+		SDL_RWseek(&ops, 0, RW_SEEK_SET);
+		TTF_Font *font = TTF_OpenFontRW(&ops, 0, 0);
+
+		if (!font)
+			return false;
+
+		const char *familyName = TTF_FontFaceFamilyName(font);
+		const char *styleName = TTF_FontFaceStyleName(font);
+
+		bool named = familyName && styleName;
+
+		if (named)
+		{
+			family = familyName;
+			style = styleName;
+		}
+
+		TTF_CloseFont(font);
+
+		if (!named)
+			return false;
+	}
+
+	addFontSet(family, style, filename);
+
+	return true;
+}
+
+void SharedFontState::addFontSet(const std::string &family,
+                                 const std::string &style,
+                                 const std::string &filename)
+{
 	FontSet &set = p->sets[family];
 
 	if (style == "Regular")
@@ -168,7 +414,7 @@ _TTF_Font *SharedFontState::getFont(std::string family,
 		                 ? req.regular.c_str() : req.other.c_str();
 
 		ops = SDL_AllocRW();
-		shState->fileSystem().openReadRaw(*ops, path, true);
+		shState->fileSystem().openReadRaw(*ops, path, true, FileSystem::ReqFont);
 	}
 
 	// FIXME 0.9 is guesswork at this point
@@ -40,9 +40,17 @@ public:
 	/* Called from FileSystem during font cache initialization
 	 * (when "Fonts/" is scanned for available assets).
 	 * 'ops' is an opened handle to a possible font file,
-	 * 'filename' is the corresponding path */
-	void initFontSetCB(SDL_RWops &ops,
-	                   const std::string &filename);
+	 * 'filename' is the corresponding path. If it is a usable
+	 * font, its family and style name are returned */
+	bool initFontSetCB(SDL_RWops &ops,
+	                   const std::string &filename,
+	                   std::string &family,
+	                   std::string &style);
+
+	/* Same, for a font file whose names are already known */
+	void addFontSet(const std::string &family,
+	                const std::string &style,
+	                const std::string &filename);
 
 	_TTF_Font *getFont(std::string family,
 	                   int size);
@@ -45,6 +45,7 @@ typedef void (APIENTRYP _PFNGLBLENDFUNCPROC) (GLenum sfactor, GLenum dfactor);
 typedef void (APIENTRYP _PFNGLBLENDFUNCSEPARATEPROC) (GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha);
 typedef void (APIENTRYP _PFNGLBLENDEQUATIONPROC) (GLenum mode);
 typedef void (APIENTRYP _PFNGLDRAWELEMENTSPROC) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
+typedef void (APIENTRYP _PFNGLFINISHPROC) (void);
 
 /* Texture */
 typedef void (APIENTRYP _PFNGLGENTEXTURESPROC) (GLsizei n, GLuint *textures);
@@ -139,6 +140,7 @@ typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 	GL_FUN(BlendFuncSeparate, _PFNGLBLENDFUNCSEPARATEPROC) \
 	GL_FUN(BlendEquation, _PFNGLBLENDEQUATIONPROC) \
 	GL_FUN(DrawElements, _PFNGLDRAWELEMENTSPROC) \
+	GL_FUN(Finish, _PFNGLFINISHPROC) \
 	/* Texture */ \
 	GL_FUN(GenTextures, _PFNGLGENTEXTURESPROC) \
 	GL_FUN(DeleteTextures, _PFNGLDELETETEXTURESPROC) \
@@ -53,6 +53,25 @@ namespace TEX
 {
 	DEF_GL_ID
 
+	/* Shadow copy of the textures bound to each texture unit,
+	 * used to filter out redundant binds. This lives outside of
+	 * GLState because textures are already bound while the
+	 * SharedState (and with it GLState) is being constructed.
+	 * Defined in glstate.cpp */
+	struct BindCache
+	{
+		enum { Units = 4 };
+
+		GLuint bound[Units];
+		unsigned int activeUnit;
+
+		/* Reported through GLState::Stats */
+		unsigned int binds;
+		unsigned int bindSkips;
+	};
+
+	extern BindCache bindCache;
+
 	inline ID gen()
 	{
 		ID id;
@@ -64,11 +83,38 @@ namespace TEX
 	static inline void del(ID id)
 	{
 		gl.DeleteTextures(1, &id.gl);
+
+		/* Deleted textures are implicitly unbound from
+		 * all units, and their name might be reused */
+		for (size_t i = 0; i < BindCache::Units; ++i)
+			if (bindCache.bound[i] == id.gl)
+				bindCache.bound[i] = 0;
 	}
 
+	static inline void setActiveUnit(unsigned int unit)
+	{
+		if (bindCache.activeUnit == unit)
+			return;
+
+		gl.ActiveTexture(GL_TEXTURE0 + unit);
+		bindCache.activeUnit = unit;
+	}
+
+	/* Binds to the currently active texture unit */
 	static inline void bind(ID id)
 	{
+		GLuint &bound = bindCache.bound[bindCache.activeUnit];
+
+		if (bound == id.gl)
+		{
+			++bindCache.bindSkips;
+			return;
+		}
+
 		gl.BindTexture(GL_TEXTURE_2D, id.gl);
+		bound = id.gl;
+
+		++bindCache.binds;
 	}
 
 	static inline void unbind()
@@ -20,12 +20,16 @@
 */
 
 #include "glstate.h"
+#include "gl-util.h"
 #include "shader.h"
 #include "etc.h"
 #include "gl-fun.h"
 
 #include <SDL_rect.h>
 
+/* Initial GL context state: texture 0 bound to all units */
+TEX::BindCache TEX::bindCache;
+
 static void applyBool(GLenum state, bool mode)
 {
 	mode ? gl.Enable(state) : gl.Disable(state);
@@ -62,6 +66,9 @@ void GLScissorTest::apply(const bool &value)
 
 void GLBlendMode::apply(const BlendType &value)
 {
+	if (value != BlendNormal)
+		nonNormalApplied = true;
+
 	switch (value)
 	{
 	case BlendKeepDestAlpha :
@@ -111,6 +118,21 @@ GLState::Caps::Caps()
 	gl.GetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexSize);
 }
 
+GLState::Stats::Stats()
+{
+	reset();
+}
+
+void GLState::Stats::reset()
+{
+	frames = 0;
+	uniformUploads = uniformSkips = 0;
+	compositeSkips = 0;
+	viewportCacheHits = 0;
+
+	TEX::bindCache.binds = TEX::bindCache.bindSkips = 0;
+}
+
 GLState::GLState()
 {
 	gl.Disable(GL_DEPTH_TEST);
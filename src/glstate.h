@@ -92,6 +92,16 @@ class GLScissorTest : public GLProperty<bool>
 
 class GLBlendMode : public GLProperty<BlendType>
 {
+public:
+	GLBlendMode()
+	    : nonNormalApplied(false)
+	{}
+
+	/* Set whenever a mode other than BlendNormal is
+	 * applied; never cleared by GLBlendMode itself */
+	bool nonNormalApplied;
+
+private:
 	void apply(const BlendType &value);
 };
 
@@ -130,6 +140,25 @@ public:
 
 	} caps;
 
+	/* Counters of GL calls issued / filtered out
+	 * by the state caches (see Graphics for reporting) */
+	struct Stats
+	{
+		unsigned int frames;
+		unsigned int uniformUploads;
+		unsigned int uniformSkips;
+
+		/* Frames presented without recompositing the screen */
+		unsigned int compositeSkips;
+
+		/* Viewports drawn from their render cache */
+		unsigned int viewportCacheHits;
+
+		Stats();
+		void reset();
+
+	} stats;
+
 	GLState();
 };
 
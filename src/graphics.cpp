@@ -45,6 +45,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <math.h>
 #include <algorithm>
 
 #define DEF_SCREEN_W  (rgssVer == 1 ? 640 : 544)
@@ -279,11 +280,17 @@ public:
 		glState.blendMode.refresh();
 	}
 
+	void restoreRenderTarget()
+	{
+		pp.startRender();
+	}
+
 	void setBrightness(float norm)
 	{
 		brightnessQuad.setColor(Vec4(0, 0, 0, 1.0 - norm));
 
 		brightEffect = norm < 1.0;
+		markDirty();
 	}
 
 	void updateReso(int width, int height)
@@ -349,6 +356,34 @@ struct FPSLimiter
 		bool resetFlag;
 	} adj;
 
+	/* Present pacing: frames are scheduled against vblanks
+	 * predicted from measured swap completion times */
+	struct
+	{
+		bool enabled;
+
+		/* Estimated display refresh period */
+		double refreshTicks;
+
+		/* Completion of the last swap (ie. last vblank) */
+		uint64_t lastSwap;
+
+		/* Ideal presentation time of the next frame */
+		uint64_t nextIdeal;
+
+		/* Busy wait this long before the target time */
+		int64_t spinMargin;
+	} pace;
+
+	/* Swap to swap frame times (in ms) */
+	struct
+	{
+		uint64_t lastSwap;
+		unsigned int count;
+		double sum;
+		double sumSq;
+	} frameTimes;
+
 	FPSLimiter(uint16_t desiredFPS)
 	    : lastTickCount(SDL_GetPerformanceCounter()),
 	      tickFreq(SDL_GetPerformanceFrequency()),
@@ -361,6 +396,11 @@ struct FPSLimiter
 		adj.last = SDL_GetPerformanceCounter();
 		adj.idealDiff = 0;
 		adj.resetFlag = false;
+
+		pace.enabled = false;
+
+		frameTimes.lastSwap = 0;
+		resetFrameTimes();
 	}
 
 	void setDesiredFPS(uint16_t value)
@@ -368,11 +408,28 @@ struct FPSLimiter
 		tpf = tickFreq / value;
 	}
 
+	void enablePacing(int refreshRate, int spinMarginUS)
+	{
+		if (refreshRate <= 0)
+			refreshRate = 60;
+
+		pace.enabled = true;
+		pace.refreshTicks = (double) tickFreq / refreshRate;
+		pace.lastSwap = pace.nextIdeal = SDL_GetPerformanceCounter();
+		pace.spinMargin = std::max(0, spinMarginUS) * (int64_t) tickFreq / 1000000;
+	}
+
 	void delay()
 	{
 		if (disabled)
 			return;
 
+		if (pace.enabled)
+		{
+			delayPaced();
+			return;
+		}
+
 		int64_t tickDelta = SDL_GetPerformanceCounter() - lastTickCount;
 		int64_t toDelay = tpf - tickDelta;
 
@@ -405,6 +462,46 @@ struct FPSLimiter
 		adj.resetFlag = true;
 	}
 
+	/* To be called as soon as the buffer swap has completed */
+	void swapCompleted()
+	{
+		uint64_t now = SDL_GetPerformanceCounter();
+
+		if (frameTimes.lastSwap != 0)
+		{
+			double ms = (now - frameTimes.lastSwap) * 1000.0 / tickFreq;
+
+			++frameTimes.count;
+			frameTimes.sum += ms;
+			frameTimes.sumSq += ms * ms;
+		}
+
+		frameTimes.lastSwap = now;
+
+		if (!pace.enabled)
+			return;
+
+		double interval = now - pace.lastSwap;
+		pace.lastSwap = now;
+
+		/* Refine the refresh period from swaps that completed
+		 * a whole number of vblanks apart; anything else means
+		 * we missed the target or were held up elsewhere */
+		double vblanks = interval / pace.refreshTicks;
+		int n = vblanks + 0.5;
+
+		if (n < 1 || n > 4 || fabs(vblanks - n) > 0.1)
+			return;
+
+		pace.refreshTicks += (interval / n - pace.refreshTicks) * 0.05;
+	}
+
+	void resetFrameTimes()
+	{
+		frameTimes.count = 0;
+		frameTimes.sum = frameTimes.sumSq = 0;
+	}
+
 	/* If we're more than a full frame's worth
 	 * of ticks behind the ideal timestep,
 	 * there's no choice but to skip frame(s)
@@ -418,6 +515,52 @@ struct FPSLimiter
 	}
 
 private:
+	void delayPaced()
+	{
+		uint64_t now = SDL_GetPerformanceCounter();
+
+		pace.nextIdeal += tpf;
+
+		if (adj.resetFlag)
+		{
+			pace.nextIdeal = now + tpf;
+			adj.resetFlag = false;
+		}
+
+		/* Present on the predicted vblank closest to the ideal
+		 * time; swapping within the refresh interval preceding
+		 * that vblank makes the frame appear on it */
+		const double refresh = pace.refreshTicks;
+		double vblanks = floor((int64_t) (pace.nextIdeal - pace.lastSwap) / refresh + 0.5);
+
+		if (vblanks < 1)
+			vblanks = 1;
+
+		uint64_t target = pace.lastSwap + (uint64_t) ((vblanks - 0.5) * refresh);
+
+		waitUntil(target);
+
+		now = lastTickCount = SDL_GetPerformanceCounter();
+
+		/* Positive when behind the ideal timestep */
+		adj.idealDiff = (int64_t) (now - pace.nextIdeal);
+	}
+
+	/* Sleeps for the bulk of the wait, then spins
+	 * through the last 'spinMargin' ticks */
+	void waitUntil(uint64_t target)
+	{
+		uint64_t now = SDL_GetPerformanceCounter();
+
+		if (now >= target)
+			return;
+
+		if ((int64_t) (target - now) > pace.spinMargin)
+			delayTicks(target - now - pace.spinMargin);
+
+		while (SDL_GetPerformanceCounter() < target) {}
+	}
+
 	void delayTicks(uint64_t ticks)
 	{
 #if defined(HAVE_NANOSLEEP)
@@ -588,11 +731,54 @@ struct GraphicsPrivate
 		fpsLimiter.delay();
 		SDL_GL_SwapWindow(threadData->window);
 
+		/* Block until the swap actually happened,
+		 * so its completion time marks the vblank */
+		if (fpsLimiter.pace.enabled)
+			gl.Finish();
+
+		fpsLimiter.swapCompleted();
+
 		++frameCount;
 
+		if (threadData->config.printRenderStats)
+			printRenderStats();
+
 		threadData->ethread->notifyFrame();
 	}
 
+	/* Prints the per frame averages of the GL state cache
+	 * counters roughly once every second */
+	void printRenderStats()
+	{
+		GLState::Stats &stats = glState.stats;
+
+		if (++stats.frames < (unsigned int) frameRate)
+			return;
+
+		const float f = stats.frames;
+
+		Debug() << "Render stats per frame:"
+		        << "uniforms" << stats.uniformUploads / f
+		        << "(skipped" << stats.uniformSkips / f << ")"
+		        << "texture binds" << TEX::bindCache.binds / f
+		        << "(skipped" << TEX::bindCache.bindSkips / f << ")"
+		        << "composites skipped" << stats.compositeSkips / f
+		        << "cached viewports" << stats.viewportCacheHits / f;
+
+		if (fpsLimiter.frameTimes.count > 0)
+		{
+			const double n = fpsLimiter.frameTimes.count;
+			const double avg = fpsLimiter.frameTimes.sum / n;
+			const double var = fpsLimiter.frameTimes.sumSq / n - avg * avg;
+
+			Debug() << "Frame time (ms): avg" << avg
+			        << "stddev" << sqrt(std::max(var, 0.0));
+		}
+
+		fpsLimiter.resetFrameTimes();
+		stats.reset();
+	}
+
 	void compositeToBuffer(TEXFBO &buffer)
 	{
 		screen.composite();
@@ -612,7 +798,12 @@ struct GraphicsPrivate
 
 	void redrawScreen()
 	{
-		screen.composite();
+		/* If nothing changed since the last frame, the
+		 * front buffer still holds an identical image */
+		if (screen.isDirty())
+			screen.composite();
+		else
+			++glState.stats.compositeSkips;
 
 		GLMeta::blitBeginScreen(winSize);
 		GLMeta::blitSource(screen.getPP().frontBuffer());
@@ -658,6 +849,9 @@ Graphics::Graphics(RGSSThreadData *data)
 	{
 		p->fpsLimiter.disabled = true;
 	}
+
+	if (data->config.vsyncPacing && !p->fpsLimiter.disabled)
+		p->fpsLimiter.enablePacing(data->refreshRate, data->config.vsyncPacingSpin);
 }
 
 Graphics::~Graphics()
@@ -988,6 +1182,7 @@ void Graphics::reset()
 	p->fpsLimiter.resetFrameAdjust();
 	p->frozen = false;
 	p->screen.getPP().clearBuffers();
+	p->screen.markDirty();
 
 	setFrameRate(DEF_FRAMERATE);
 	setBrightness(255);
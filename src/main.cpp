@@ -104,7 +104,7 @@ int rgssThreadFun(void *userdata)
 
 	printGLInfo();
 
-	bool vsync = conf.vsync || conf.syncToRefreshrate;
+	bool vsync = conf.vsync || conf.syncToRefreshrate || conf.vsyncPacing;
 	SDL_GL_SetSwapInterval(vsync ? 1 : 0);
 
 	GLDebugLogger dLogger;
@@ -0,0 +1,775 @@
+/*
+** midicache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "midicache.h"
+
+#include "aldatasource.h"
+#include "config.h"
+#include "sharedmidistate.h"
+#include "exception.h"
+#include "boost-hash.h"
+#include "debugwriter.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+
+#include <zlib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+
+/* A rendering file consists of a header, the chunks (each
+ * holding up to 'chunkFrames' stereo frames, deflated) and
+ * a table with the file offset of every chunk plus the end
+ * offset of the last one. It's only ever read back on the
+ * machine that wrote it, so everything is in host order */
+#define CACHE_MAGIC "MKXPMC2"
+
+/* Songs whose rendering would run longer than this are left
+ * to live synthesis */
+#define MAX_RENDER_SECS (10*60)
+
+struct CacheHeader
+{
+	char magic[8];
+	uint64_t key;
+	/* Settings part of the key, so renderings made
+	 * with other settings can be told apart */
+	uint64_t settings;
+	uint32_t rate;
+	uint32_t frames;
+
+	/* Non zero if playback continues at 'loopStart'
+	 * after the last frame instead of ending */
+	uint32_t loops;
+	uint32_t loopStart;
+
+	uint32_t chunkFrames;
+	uint32_t chunkCount;
+	uint32_t tableOffset;
+};
+
+static const uint64_t fnvOffset = 14695981039346656037ULL;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/* Chunks are stored as per channel sample deltas, split into
+ * a plane of low and one of high bytes, which deflates much
+ * better than the interleaved samples themselves */
+static void encodeChunk(const int16_t *samples, uint32_t frames,
+                        std::vector<uint8_t> &planes)
+{
+	const uint32_t count = frames * 2;
+	planes.resize(count * 2);
+
+	uint8_t *lo = &planes[0];
+	uint8_t *hi = &planes[count];
+	uint16_t prev[2] = { 0, 0 };
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint16_t s = samples[i];
+		uint16_t d = s - prev[i & 1];
+		prev[i & 1] = s;
+
+		lo[i] = d & 0xFF;
+		hi[i] = d >> 8;
+	}
+}
+
+static void decodeChunk(const std::vector<uint8_t> &planes, uint32_t frames,
+                        int16_t *samples)
+{
+	const uint32_t count = frames * 2;
+
+	const uint8_t *lo = &planes[0];
+	const uint8_t *hi = &planes[count];
+	uint16_t prev[2] = { 0, 0 };
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint16_t d = lo[i] | (hi[i] << 8);
+		prev[i & 1] += d;
+
+		samples[i] = prev[i & 1];
+	}
+}
+
+static bool readHeader(SDL_RWops *ops, uint64_t key,
+                       CacheHeader &hdr, std::vector<uint32_t> &table)
+{
+	if (SDL_RWread(ops, &hdr, sizeof(hdr), 1) != 1)
+		return false;
+
+	if (memcmp(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic)))
+		return false;
+
+	if (hdr.key != key || hdr.rate != SYNTH_SAMPLERATE)
+		return false;
+
+	if (hdr.frames == 0 || hdr.chunkFrames == 0)
+		return false;
+
+	if (hdr.loops && hdr.loopStart >= hdr.frames)
+		return false;
+
+	if (hdr.chunkCount != (hdr.frames + hdr.chunkFrames - 1) / hdr.chunkFrames)
+		return false;
+
+	table.resize(hdr.chunkCount + 1);
+
+	if (SDL_RWseek(ops, hdr.tableOffset, RW_SEEK_SET) < 0)
+		return false;
+
+	if (SDL_RWread(ops, &table[0], sizeof(uint32_t), table.size()) != table.size())
+		return false;
+
+	for (size_t i = 0; i < hdr.chunkCount; ++i)
+		if (table[i] > table[i+1])
+			return false;
+
+	return true;
+}
+
+struct MidiCacheSource : ALDataSource
+{
+	SDL_RWops *ops;
+
+	CacheHeader hdr;
+	std::vector<uint32_t> table;
+
+	std::vector<uint8_t> packed;
+	std::vector<uint8_t> planes;
+
+	/* Samples of the chunk last read */
+	std::vector<int16_t> chunk;
+	uint32_t chunkI;
+	bool chunkValid;
+
+	std::vector<int16_t> sampleBuf;
+	uint32_t currentFrame;
+
+	/* A rendering can't be transposed without also changing its
+	 * tempo, so if a pitch is requested before playback starts,
+	 * we go back to synthesizing the midi data */
+	std::vector<uint8_t> midiData;
+	bool looped;
+	ALDataSource *live;
+	bool started;
+
+	MidiCacheSource(SDL_RWops *ops, const CacheHeader &hdr,
+	                const std::vector<uint32_t> &table,
+	                const std::vector<uint8_t> &data, bool looped)
+	    : ops(ops),
+	      hdr(hdr),
+	      table(table),
+	      chunk(hdr.chunkFrames * 2),
+	      chunkI(0),
+	      chunkValid(false),
+	      sampleBuf(STREAM_BUF_SIZE * 2),
+	      currentFrame(0),
+	      midiData(data),
+	      looped(looped),
+	      live(0),
+	      started(false)
+	{}
+
+	~MidiCacheSource()
+	{
+		delete live;
+		SDL_RWclose(ops);
+	}
+
+	bool loadChunk(uint32_t i)
+	{
+		if (chunkValid && chunkI == i)
+			return true;
+
+		chunkValid = false;
+
+		uint32_t frames = std::min(hdr.chunkFrames, hdr.frames - i * hdr.chunkFrames);
+		uint32_t size = table[i+1] - table[i];
+
+		packed.resize(size);
+		planes.resize(frames * 4);
+
+		if (SDL_RWseek(ops, table[i], RW_SEEK_SET) < 0)
+			return false;
+
+		if (SDL_RWread(ops, &packed[0], 1, size) != size)
+			return false;
+
+		uLongf planesLen = planes.size();
+
+		if (uncompress(&planes[0], &planesLen, &packed[0], size) != Z_OK)
+			return false;
+
+		if (planesLen != planes.size())
+			return false;
+
+		decodeChunk(planes, frames, &chunk[0]);
+
+		chunkI = i;
+		chunkValid = true;
+
+		return true;
+	}
+
+	Status fillBuffer(AL::Buffer::ID alBuffer)
+	{
+		if (live)
+			return live->fillBuffer(alBuffer);
+
+		started = true;
+
+		const uint32_t bufFrames = sampleBuf.size() / 2;
+		uint32_t filled = 0;
+		Status status = NoError;
+
+		while (filled < bufFrames)
+		{
+			uint32_t i = currentFrame / hdr.chunkFrames;
+
+			if (!loadChunk(i))
+				return Error;
+
+			uint32_t chunkOff = currentFrame - i * hdr.chunkFrames;
+			uint32_t chunkEnd = std::min(hdr.chunkFrames, hdr.frames - i * hdr.chunkFrames);
+			uint32_t count = std::min(chunkEnd - chunkOff, bufFrames - filled);
+
+			memcpy(&sampleBuf[filled*2], &chunk[chunkOff*2], count * sizeof(int16_t) * 2);
+			filled += count;
+			currentFrame += count;
+
+			if (currentFrame < hdr.frames)
+				continue;
+
+			if (hdr.loops)
+			{
+				currentFrame = hdr.loopStart;
+				status = WrapAround;
+			}
+			else
+			{
+				status = EndOfStream;
+			}
+
+			break;
+		}
+
+		AL::Buffer::uploadData(alBuffer, AL_FORMAT_STEREO16, &sampleBuf[0],
+		                       filled * sizeof(int16_t) * 2, hdr.rate);
+
+		return status;
+	}
+
+	int sampleRate()
+	{
+		if (live)
+			return live->sampleRate();
+
+		return hdr.rate;
+	}
+
+	void seekToOffset(float seconds)
+	{
+		if (live)
+			return live->seekToOffset(seconds);
+
+		uint64_t frame = seconds > 0 ? seconds * hdr.rate : 0;
+
+		if (frame >= hdr.frames)
+		{
+			if (hdr.loops)
+				frame = hdr.loopStart + (frame - hdr.loopStart) % (hdr.frames - hdr.loopStart);
+			else
+				frame = 0;
+		}
+
+		currentFrame = frame;
+	}
+
+	uint32_t loopStartFrames()
+	{
+		if (live)
+			return live->loopStartFrames();
+
+		return hdr.loopStart;
+	}
+
+	bool setPitch(float value)
+	{
+		if (live)
+			return live->setPitch(value);
+
+		if (value == 1.0f)
+			return true;
+
+		/* Already playing; resampling is the best we can do */
+		if (started)
+			return false;
+
+		live = createLiveMidiSource(midiData, looped);
+
+		return live->setPitch(value);
+	}
+};
+
+struct MidiCachePrivate
+{
+	std::string dir;
+
+	/* Hash over everything besides the midi data
+	 * itself that goes into a rendering */
+	uint64_t settingsKey;
+
+	struct Job
+	{
+		std::vector<uint8_t> data;
+		uint64_t key;
+		bool looped;
+	};
+
+	std::deque<Job> queue;
+
+	/* Keys that have been queued this session, so failed
+	 * renderings aren't attempted over and over */
+	BoostSet<uint64_t> claimed;
+
+	/* Renderings are pruned, least recently played
+	 * first, to stay within this many bytes */
+	uint64_t budget;
+
+	SDL_mutex *mut;
+	SDL_cond *cond;
+	SDL_Thread *thread;
+	AtomicFlag termReq;
+
+	MidiCachePrivate(const Config &conf, const char *cacheDir)
+	    : dir(cacheDir),
+	      budget((uint64_t) conf.midi.renderCacheSize * 1024 * 1024),
+	      mut(SDL_CreateMutex()),
+	      cond(SDL_CreateCond()),
+	      thread(0)
+	{
+		const std::string &soundFont = conf.midi.soundFont;
+
+		/* The soundfont's size stands in for its contents, which
+		 * are too big to hash on every startup */
+		int64_t sfSize = -1;
+		SDL_RWops *sf = RWFromFile(soundFont.c_str(), "rb");
+
+		if (sf)
+		{
+			sfSize = SDL_RWsize(sf);
+			SDL_RWclose(sf);
+		}
+
+		uint8_t effects[] = { conf.midi.chorus, conf.midi.reverb };
+		uint32_t rate = SYNTH_SAMPLERATE;
+
+		settingsKey = fnv1a(fnvOffset, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		settingsKey = fnv1a(settingsKey, soundFont.c_str(), soundFont.size());
+		settingsKey = fnv1a(settingsKey, &sfSize, sizeof(sfSize));
+		settingsKey = fnv1a(settingsKey, effects, sizeof(effects));
+		settingsKey = fnv1a(settingsKey, &rate, sizeof(rate));
+
+		/* Started right away to clean up after earlier runs */
+		thread = createSDLThread
+			<MidiCachePrivate, &MidiCachePrivate::renderJobs>(this, "midicache");
+	}
+
+	~MidiCachePrivate()
+	{
+		if (thread)
+		{
+			SDL_LockMutex(mut);
+			termReq.set();
+			SDL_CondSignal(cond);
+			SDL_UnlockMutex(mut);
+
+			SDL_WaitThread(thread, 0);
+		}
+
+		SDL_DestroyCond(cond);
+		SDL_DestroyMutex(mut);
+	}
+
+	uint64_t midiKey(const std::vector<uint8_t> &data, bool looped) const
+	{
+		uint8_t loopFlag = looped;
+
+		uint64_t key = fnv1a(settingsKey, &data[0], data.size());
+
+		return fnv1a(key, &loopFlag, sizeof(loopFlag));
+	}
+
+	std::string pathFor(uint64_t key) const
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "midi-%08x%08x.pcm",
+		         (uint32_t) (key >> 32), (uint32_t) key);
+
+		return dir + buf;
+	}
+
+	void queueRender(const std::vector<uint8_t> &data, uint64_t key, bool looped)
+	{
+		SDL_LockMutex(mut);
+
+		if (!claimed.contains(key))
+		{
+			claimed.insert(key);
+
+			queue.push_back(Job());
+			queue.back().data = data;
+			queue.back().key = key;
+			queue.back().looped = looped;
+
+			SDL_CondSignal(cond);
+		}
+
+		SDL_UnlockMutex(mut);
+	}
+
+	void renderJobs()
+	{
+		/* Don't compete with the game and the audio thread */
+		SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+		prune();
+
+		SDL_LockMutex(mut);
+
+		while (true)
+		{
+			while (queue.empty() && !termReq)
+				SDL_CondWait(cond, mut);
+
+			if (termReq)
+				break;
+
+			Job job;
+			job.data.swap(queue.front().data);
+			job.key = queue.front().key;
+			job.looped = queue.front().looped;
+			queue.pop_front();
+
+			SDL_UnlockMutex(mut);
+
+			render(job);
+			prune(pathFor(job.key));
+
+			SDL_LockMutex(mut);
+		}
+
+		SDL_UnlockMutex(mut);
+	}
+
+	void render(const Job &job)
+	{
+		MidiRenderer *renderer;
+
+		try
+		{
+			renderer = createMidiRenderer(job.data, job.looped);
+		}
+		catch (const Exception &e)
+		{
+			Debug() << "MIDI cache: Unable to render:" << e.msg;
+			return;
+		}
+
+		const std::string path = pathFor(job.key);
+		const std::string tmpPath = path + ".tmp";
+
+		uint32_t startTicks = SDL_GetTicks();
+		bool ok = write(tmpPath, *renderer, job.key);
+
+		delete renderer;
+
+		if (ok && rename(tmpPath.c_str(), path.c_str()) == 0)
+		{
+			Debug() << "MIDI cache: Rendered" << path << "in"
+			        << SDL_GetTicks() - startTicks << "ms";
+			return;
+		}
+
+		remove(tmpPath.c_str());
+	}
+
+	struct CacheFile
+	{
+		std::string path;
+		uint64_t size;
+		time_t lastUsed;
+
+		bool operator<(const CacheFile &o) const
+		{
+			return lastUsed < o.lastUsed;
+		}
+	};
+
+	/* Deletes renderings that are damaged, left over from
+	 * interrupted renders or made with other settings, then
+	 * the least recently played ones until within budget.
+	 * 'keep' is spared, even if it is over budget on its own */
+	void prune(const std::string &keep = std::string())
+	{
+		DIR *d = opendir(dir.c_str());
+
+		if (!d)
+			return;
+
+		std::vector<CacheFile> files;
+		uint64_t total = 0;
+
+		while (struct dirent *e = readdir(d))
+		{
+			const char *name = e->d_name;
+			size_t len = strlen(name);
+
+			if (strncmp(name, "midi-", 5) || len < 9)
+				continue;
+
+			std::string path = dir + name;
+			bool valid = false;
+
+			if (!strcmp(name + len - 4, ".pcm"))
+			{
+				uint64_t key = strtoull(name + 5, 0, 16);
+				CacheHeader hdr;
+				std::vector<uint32_t> table;
+				SDL_RWops *ops = RWFromFile(path.c_str(), "rb");
+
+				if (ops)
+				{
+					valid = readHeader(ops, key, hdr, table)
+					     && hdr.settings == settingsKey;
+					SDL_RWclose(ops);
+				}
+			}
+			else if (strcmp(name + len - 4, ".tmp"))
+			{
+				continue;
+			}
+
+			struct stat st;
+
+			if (valid && stat(path.c_str(), &st) == 0)
+			{
+				CacheFile file = { path, (uint64_t) st.st_size, st.st_mtime };
+				files.push_back(file);
+				total += file.size;
+
+				continue;
+			}
+
+			/* Renders only happen on this thread, so
+			 * temporary files are always left over */
+			remove(path.c_str());
+		}
+
+		closedir(d);
+
+		if (total <= budget)
+			return;
+
+		std::sort(files.begin(), files.end());
+
+		for (size_t i = 0; i < files.size() && total > budget; ++i)
+		{
+			if (files[i].path == keep)
+				continue;
+
+			if (remove(files[i].path.c_str()) == 0)
+				total -= files[i].size;
+		}
+	}
+
+	bool write(const std::string &path, MidiRenderer &renderer, uint64_t key)
+	{
+		SDL_RWops *f = RWFromFile(path.c_str(), "wb");
+
+		if (!f)
+			return false;
+
+		CacheHeader hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+		hdr.key = key;
+		hdr.settings = settingsKey;
+		hdr.rate = SYNTH_SAMPLERATE;
+		hdr.chunkFrames = STREAM_BUF_SIZE;
+
+		/* Placeholder until the rendering is complete */
+		bool ok = SDL_RWwrite(f, &hdr, sizeof(hdr), 1) == 1;
+
+		std::vector<int16_t> block(STREAM_BUF_SIZE * 2);
+		std::vector<uint32_t> wraps;
+		std::vector<uint8_t> planes;
+		std::vector<uint8_t> packed;
+		std::vector<uint32_t> table;
+
+		uint32_t offset = sizeof(hdr);
+		uint32_t wrapCount = 0;
+		bool done = false;
+
+		/* When looped, the song is rendered up to its second wrap
+		 * around: the first pass through the loop still carries the
+		 * intro's decaying notes, while the second one carries its
+		 * own, which is what every later pass sounds like */
+		while (ok && !done)
+		{
+			if (termReq || hdr.frames > MAX_RENDER_SECS * hdr.rate)
+			{
+				ok = false;
+				break;
+			}
+
+			wraps.clear();
+			done = !renderer.renderBlock(&block[0], wraps);
+
+			uint32_t blockFrames = STREAM_BUF_SIZE;
+
+			for (size_t i = 0; i < wraps.size(); ++i)
+			{
+				if (wrapCount++ == 0)
+				{
+					hdr.loopStart = hdr.frames + wraps[i];
+					continue;
+				}
+
+				blockFrames = wraps[i];
+				hdr.loops = 1;
+				done = true;
+				break;
+			}
+
+			if (blockFrames == 0)
+				break;
+
+			encodeChunk(&block[0], blockFrames, planes);
+
+			uLongf packedLen = compressBound(planes.size());
+			packed.resize(packedLen);
+
+			if (compress(&packed[0], &packedLen, &planes[0], planes.size()) != Z_OK)
+			{
+				ok = false;
+				break;
+			}
+
+			table.push_back(offset);
+			ok = SDL_RWwrite(f, &packed[0], 1, packedLen) == packedLen;
+			offset += packedLen;
+
+			hdr.frames += blockFrames;
+			hdr.chunkCount++;
+		}
+
+		if (!hdr.loops)
+			hdr.loopStart = 0;
+
+		table.push_back(offset);
+		hdr.tableOffset = offset;
+
+		if (ok)
+			ok = hdr.frames > 0;
+
+		if (ok)
+			ok = SDL_RWwrite(f, &table[0], sizeof(uint32_t), table.size()) == table.size();
+
+		if (ok)
+			ok = SDL_RWseek(f, 0, RW_SEEK_SET) == 0
+			  && SDL_RWwrite(f, &hdr, sizeof(hdr), 1) == 1;
+
+		SDL_RWclose(f);
+
+		return ok;
+	}
+};
+
+MidiCache::MidiCache(const Config &conf, const char *cacheDir)
+{
+	p = new MidiCachePrivate(conf, cacheDir);
+}
+
+MidiCache::~MidiCache()
+{
+	delete p;
+}
+
+ALDataSource *MidiCache::open(const std::vector<uint8_t> &data, bool looped)
+{
+	if (data.empty())
+		return 0;
+
+	uint64_t key = p->midiKey(data, looped);
+	std::string path = p->pathFor(key);
+
+	SDL_RWops *ops = RWFromFile(path.c_str(), "rb");
+
+	if (ops)
+	{
+		CacheHeader hdr;
+		std::vector<uint32_t> table;
+
+		if (readHeader(ops, key, hdr, table))
+		{
+			/* Marks it as recently played for pruning */
+			utime(path.c_str(), 0);
+
+			return new MidiCacheSource(ops, hdr, table, data, looped);
+		}
+
+		/* Stale or damaged, render it again */
+		SDL_RWclose(ops);
+		remove(path.c_str());
+	}
+
+	p->queueRender(data, key, looped);
+
+	return 0;
+}
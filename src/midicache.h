@@ -0,0 +1,71 @@
+/*
+** midicache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MIDICACHE_H
+#define MIDICACHE_H
+
+#include <stdint.h>
+#include <vector>
+
+struct ALDataSource;
+struct Config;
+struct MidiCachePrivate;
+
+/* Keeps renderings of midi files on disk, so they can be
+ * streamed back instead of being synthesized every time.
+ * A rendering is keyed by the midi data and everything else
+ * that affects the synthesized output (soundfont, effects),
+ * and repeats from the song's loop point when looped */
+class MidiCache
+{
+public:
+	MidiCache(const Config &conf, const char *cacheDir);
+	~MidiCache();
+
+	/* Returns a source streaming the rendering of 'data', or 0 if
+	 * there is none yet, in which case one is queued for rendering
+	 * on a background thread */
+	ALDataSource *open(const std::vector<uint8_t> &data, bool looped);
+
+private:
+	MidiCachePrivate *p;
+};
+
+/* Synthesizes a midi file block by block (midisource.cpp) */
+struct MidiRenderer
+{
+	virtual ~MidiRenderer() {}
+
+	/* Renders the next STREAM_BUF_SIZE stereo frames into 'buf',
+	 * appending the frame offsets into the block at which the song
+	 * wrapped back to its loop point to 'wraps'. Returns false once
+	 * a non looped song has ended */
+	virtual bool renderBlock(int16_t *buf, std::vector<uint32_t> &wraps) = 0;
+};
+
+MidiRenderer *createMidiRenderer(const std::vector<uint8_t> &data,
+                                 bool looped);
+
+/* Always synthesizes in real time, bypassing the cache */
+ALDataSource *createLiveMidiSource(const std::vector<uint8_t> &data,
+                                   bool looped);
+
+#endif // MIDICACHE_H
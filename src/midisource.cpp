@@ -20,6 +20,7 @@
 */
 
 #include "aldatasource.h"
+#include "midicache.h"
 
 #include "al-util.h"
 #include "exception.h"
@@ -57,12 +58,24 @@
 #define DEFAULT_BPM 120
 #define MAX_CHANNELS 16
 
+#define CC_CTRL_DATA_MSB     6
 #define CC_CTRL_VOLUME       7
 #define CC_CTRL_EXPRESSION  11
+#define CC_CTRL_DATA_LSB    38
+#define CC_CTRL_DATA_INC    96
+#define CC_CTRL_DATA_DEC    97
 #define CC_CTRL_LOOP       111
+#define CC_CTRL_RESET_ALL  121
+
+/* Controllers from here on are channel mode messages */
+#define CC_CTRL_MODE_FIRST 120
 
 #define CC_VAL_DEFAULT 127
 
+/* A snapshot of the synth state is taken every
+ * this many events along the timeline */
+#define SNAPSHOT_EVENTS 256
+
 enum MidiEventType
 {
 	NoteOff,
@@ -445,86 +458,177 @@ void readMidi(MidiReadHandler *handler, const std::vector<uint8_t> &data)
 		readMidiTrack(handler, chunk);
 }
 
-struct Track
+/* An event together with its absolute position in deltas
+ * from the beginning of the song */
+struct TimedEvent
 {
-	std::vector<MidiEvent> events;
+	uint32_t pos;
+	MidiEvent e;
 
-	/* Combined deltas of all events */
-	uint64_t length;
+	bool operator<(const TimedEvent &o) const
+	{
+		return pos < o.pos;
+	}
+};
 
-	/* Event index that is resumed from after loop wraparound */
-	int32_t loopI;
+/* Controller state of a channel, as far as it matters
+ * for picking up playback in the middle of a song */
+struct ChannelState
+{
+	uint8_t cc[128];
 
-	/* Difference between last event's position and length of
-	 * the longest overall track / song length */
-	uint32_t loopOffsetEnd;
+	/* One bit for each controller that has been changed */
+	uint32_t ccSet[4];
 
-	/* Delta offset from the loop beginning to event[loopI] */
-	uint32_t loopOffsetStart;
+	/* Negative if never changed */
+	int16_t prog;
+	int16_t pressure;
+	int32_t pitchBend;
 
-	bool valid;
-	MidiEvent event;
-	int32_t remDeltas;
+	ChannelState()
+	{
+		memset(cc, 0, sizeof(cc));
+		memset(ccSet, 0, sizeof(ccSet));
+		prog = pressure = -1;
+		pitchBend = -1;
+	}
 
-	uint32_t index;
-	bool wrapAroundFlag;
-	bool atEnd;
+	bool isSet(uint8_t ctrl) const
+	{
+		return ccSet[ctrl >> 5] & (1u << (ctrl & 31));
+	}
 
-	Track()
-	    : length(0),
-	      loopI(-1),
-	      loopOffsetEnd(0),
-	      loopOffsetStart(0),
-	      valid(false),
-	      index(0),
-	      wrapAroundFlag(false),
-	      atEnd(false)
-	{}
+	void setCC(uint8_t ctrl, uint8_t val)
+	{
+		cc[ctrl] = val;
+		ccSet[ctrl >> 5] |= (1u << (ctrl & 31));
+	}
 
-	void appendEvent(const MidiEvent &e)
+	/* Bank select, volume, pan, effect depths and
+	 * parameter numbers are kept (as per RP-015) */
+	static bool keptOnReset(uint8_t ctrl)
 	{
-		length += e.delta;
-		events.push_back(e);
+		return ctrl == 0 || ctrl == 32 || ctrl == 7 || ctrl == 10
+		    || (ctrl >= 91 && ctrl <= 95) || (ctrl >= 98 && ctrl <= 101);
 	}
 
-	void scheduleEvent(bool looped)
+	void resetControllers()
 	{
-		if (valid)
-			return;
+		for (uint8_t ctrl = 0; ctrl < CC_CTRL_MODE_FIRST; ++ctrl)
+			if (!keptOnReset(ctrl))
+				ccSet[ctrl >> 5] &= ~(1u << (ctrl & 31));
 
-		/* At end and not looped? */
-		if (index == events.size() && ((!looped || loopI < 0) || length == 0))
-		{
-			valid = false;
-			atEnd = true;
-			return;
-		}
+		pressure = -1;
+		pitchBend = -1;
+	}
+};
 
-		MidiEvent &e = events[index++];
+struct SynthState
+{
+	uint32_t bpm;
+	ChannelState chans[MAX_CHANNELS];
 
-		event = e;
-		remDeltas = e.delta;
-		valid = true;
+	SynthState()
+	    : bpm(DEFAULT_BPM)
+	{}
 
-		if (wrapAroundFlag)
+	/* Notes are ignored; they can't be picked up halfway */
+	void apply(const MidiEvent &e)
+	{
+		if (e.type == Tempo)
 		{
-			remDeltas = loopOffsetEnd + loopOffsetStart;
-			wrapAroundFlag = false;
+			bpm = e.e.tempo.bpm;
+			return;
 		}
 
-		if (looped && (index == events.size()) && loopI >= 0)
+		ChannelState &chan = chans[e.e.chan.chan];
+
+		switch (e.type)
 		{
-			index = loopI;
-			wrapAroundFlag = true;
+		case CC:
+			if (e.e.cc.ctrl == CC_CTRL_RESET_ALL)
+				chan.resetControllers();
+			/* These act on the moment rather than set a value */
+			else if (e.e.cc.ctrl < CC_CTRL_MODE_FIRST
+			         && e.e.cc.ctrl != CC_CTRL_DATA_INC
+			         && e.e.cc.ctrl != CC_CTRL_DATA_DEC)
+				chan.setCC(e.e.cc.ctrl, e.e.cc.val);
+			break;
+		case PC:
+			chan.prog = e.e.pc.prog;
+			break;
+		case PitchBend:
+			chan.pitchBend = e.e.pitchBend.val;
+			break;
+		case ChanTouch:
+			chan.pressure = e.e.chanTouch.val;
+			break;
+		default:
+			break;
 		}
 	}
+};
 
-	void reset()
+struct Snapshot
+{
+	/* Index of the first event not reflected in 'state' */
+	size_t index;
+	SynthState state;
+};
+
+/* Converts between positions and time over one pass
+ * through (a stretch of) the timeline */
+struct TempoMap
+{
+	/* A tempo change, with the time into the pass it happens at */
+	struct Point
 	{
-		valid = false;
-		index = 0;
-		wrapAroundFlag = false;
-		atEnd = false;
+		uint32_t pos;
+		double secs;
+		uint32_t bpm;
+	};
+
+	std::vector<Point> points;
+	uint16_t dpb;
+
+	void init(uint32_t pos, uint32_t bpm, uint16_t dpb)
+	{
+		this->dpb = dpb;
+
+		Point p = { pos, 0, bpm };
+		points.assign(1, p);
+	}
+
+	void addChange(uint32_t pos, uint32_t bpm)
+	{
+		Point p = { pos, secondsAt(pos), bpm };
+		points.push_back(p);
+	}
+
+	double secondsAt(uint32_t pos) const
+	{
+		size_t i = points.size();
+
+		while (--i > 0)
+			if (points[i].pos <= pos)
+				break;
+
+		const Point &p = points[i];
+
+		return p.secs + (pos - p.pos) * 60.0 / (dpb * p.bpm);
+	}
+
+	double positionAt(double secs) const
+	{
+		size_t i = points.size();
+
+		while (--i > 0)
+			if (points[i].secs <= secs)
+				break;
+
+		const Point &p = points[i];
+
+		return p.pos + (secs - p.secs) * dpb * p.bpm / 60.0;
 	}
 };
 
@@ -549,8 +653,10 @@ struct CCResetter
 		memset(&chanHandled, 0, sizeof(chanHandled));
 	}
 
-	void handleEvent(const MidiEvent &e, Track &track)
+	void handleEvent(const TimedEvent &te, std::vector<TimedEvent> &events)
 	{
+		const MidiEvent &e = te.e;
+
 		if (e.type != NoteOn && e.type != CC)
 			return;
 
@@ -569,37 +675,59 @@ struct CCResetter
 		{
 			chanHandled[chan] = true;
 
-			MidiEvent re;
-			re.delta = 0;
-			re.type = CC;
-			re.e.cc.chan = chan;
-			re.e.cc.ctrl = ctrl;
-			re.e.cc.val = CC_VAL_DEFAULT;
+			TimedEvent re;
+			re.pos = te.pos;
+			re.e.delta = 0;
+			re.e.type = CC;
+			re.e.e.cc.chan = chan;
+			re.e.e.cc.ctrl = ctrl;
+			re.e.e.cc.val = CC_VAL_DEFAULT;
 
-			track.appendEvent(re);
+			events.push_back(re);
 		}
 	}
 };
 
-struct MidiSource : ALDataSource, MidiReadHandler
+struct MidiSource : ALDataSource, MidiReadHandler, MidiRenderer
 {
 	const uint16_t freq;
 	fluid_synth_t *synth;
 
 	int16_t synthBuf[BUF_TICKS*TICK_FRAMES*2];
 
-	std::vector<Track> tracks;
+	/* The events of all tracks merged into one timeline */
+	std::vector<TimedEvent> events;
 	CCResetter<CC_CTRL_VOLUME>     volReset;
 	CCResetter<CC_CTRL_EXPRESSION> expReset;
 
-	/* Index of longest track */
-	uint8_t longestI;
+	/* Position of the last event */
+	uint32_t length;
+
+	/* The first pass through the song */
+	std::vector<Snapshot> snapshots;
+	TempoMap tempoMap;
+
+	/* Any later pass through the loop, which starts out with
+	 * the state the previous one ended in (only when looped) */
+	std::vector<Snapshot> loopSnapshots;
+	TempoMap loopTempoMap;
 
 	bool looped;
 
 	/* Absolute delta at which we received the LOOP_MARKER CC event */
 	uint32_t loopDelta;
 
+	/* First event at or after the loop point */
+	size_t loopI;
+
+	/* Next event to be activated */
+	size_t cursor;
+
+	/* Playback position in deltas */
+	double curPos;
+
+	bool atEnd;
+
 	/* Deltas per beat */
 	uint16_t dpb;
 
@@ -608,83 +736,142 @@ struct MidiSource : ALDataSource, MidiReadHandler
 	/* Deltas per tick */
 	float playbackSpeed;
 
-	float genDeltasCarry;
-
 	/* MidiReadHandler (track that's currently being read) */
 	int16_t curTrack;
+	uint16_t trackCount;
 
-	MidiSource(SDL_RWops &ops,
+	MidiSource(const std::vector<uint8_t> &data,
 	           bool looped)
 	    : freq(SYNTH_SAMPLERATE),
+	      length(0),
 	      looped(looped),
+	      loopDelta(0),
+	      loopI(0),
+	      cursor(0),
+	      curPos(0),
+	      atEnd(false),
 	      dpb(480),
 	      pitchShift(0),
-	      genDeltasCarry(0),
-	      curTrack(-1)
+	      curTrack(-1),
+	      trackCount(0)
 	{
-		size_t dataLen = SDL_RWsize(&ops);
-		std::vector<uint8_t> data(dataLen);
-
-		if (SDL_RWread(&ops, &data[0], 1, dataLen) < dataLen)
-			throw Exception(Exception::MKXPError, "Reading midi data failed");
-
 		readMidi(this, data);
 
 		synth = shState->midiState().allocateSynth();
 
-		uint64_t longest = 0;
-
-		for (size_t i = 0; i < tracks.size(); ++i)
-			if (tracks[i].length > longest)
-			{
-				longest = tracks[i].length;
-				longestI = i;
-			}
+		/* Tracks were appended one after another; a stable sort keeps
+		 * simultaneous events in track order, and the fake CC events
+		 * right behind the NoteOn events that triggered them */
+		std::stable_sort(events.begin(), events.end());
 
-		for (size_t i = 0; i < tracks.size(); ++i)
-			tracks[i].loopOffsetEnd = longest - tracks[i].length;
+		if (!events.empty())
+			length = events.back().pos;
 
 		/* Enterbrain likes to be funny and put loop markers at
 		 * the very end of ME tracks */
-		if (loopDelta >= longest)
+		if (loopDelta >= length)
 			loopDelta = 0;
 
-		for (size_t i = 0; i < tracks.size(); ++i)
-		{
-			Track &track = tracks[i];
+		loopI = eventIndexAt(loopDelta);
 
-			int64_t base = 0;
-			for (size_t j = 0; j < track.events.size(); ++j)
-			{
-				MidiEvent &e = track.events[j];
-				base += e.delta;
+		buildTimeline();
 
-				if (base < loopDelta)
-					continue;
+		updatePlaybackSpeed(DEFAULT_BPM);
+	}
 
-				/* Don't make the last event loop eternally */
-				if (j < track.events.size())
-				{
-					track.loopI = j;
-					track.loopOffsetStart = base - loopDelta;
-				}
+	~MidiSource()
+	{
+		shState->midiState().releaseSynth(synth);
+	}
 
-				break;
+	/* Records the synth state snapshots and tempo changes
+	 * of one pass through the events from 'first' on */
+	void recordPass(size_t first, SynthState &state,
+	                std::vector<Snapshot> &snaps, TempoMap &tempo)
+	{
+		for (size_t i = first; i < events.size(); ++i)
+		{
+			if ((i - first) % SNAPSHOT_EVENTS == 0)
+			{
+				snaps.push_back(Snapshot());
+				snaps.back().index = i;
+				snaps.back().state = state;
 			}
+
+			const TimedEvent &te = events[i];
+			state.apply(te.e);
+
+			if (te.e.type == Tempo)
+				tempo.addChange(te.pos, te.e.e.tempo.bpm);
 		}
 
-		updatePlaybackSpeed(DEFAULT_BPM);
+		if (snaps.empty())
+		{
+			snaps.push_back(Snapshot());
+			snaps.back().index = first;
+			snaps.back().state = state;
+		}
+	}
 
-		// FIXME: It would make the code in 'fillBuffer' a lot nicer if
-		// we could combine all tracks into one giant one on construction,
-		// instead of having to constantly iterate through all of them
+	void buildTimeline()
+	{
+		SynthState state;
+
+		tempoMap.init(0, state.bpm, dpb);
+		recordPass(0, state, snapshots, tempoMap);
+
+		if (!looped || length == 0)
+			return;
+
+		/* Once looped, the state carries over from the end
+		 * of the song, and so does the tempo */
+		loopTempoMap.init(loopDelta, state.bpm, dpb);
+		recordPass(loopI, state, loopSnapshots, loopTempoMap);
 	}
 
-	~MidiSource()
+	/* Brings the synth into 'state' from scratch */
+	void restoreState(const SynthState &state)
 	{
-		shState->midiState().releaseSynth(synth);
+		fluid.synth_system_reset(synth);
+
+		for (int i = 0; i < MAX_CHANNELS; ++i)
+		{
+			const ChannelState &chan = state.chans[i];
+
+			/* Data entry comes last so it lands on the
+			 * restored (N)RPN parameter */
+			for (int ctrl = 0; ctrl < CC_CTRL_MODE_FIRST; ++ctrl)
+				if (chan.isSet(ctrl) && ctrl != CC_CTRL_DATA_MSB && ctrl != CC_CTRL_DATA_LSB)
+					fluid.synth_cc(synth, i, ctrl, chan.cc[ctrl]);
+
+			if (chan.isSet(CC_CTRL_DATA_MSB))
+				fluid.synth_cc(synth, i, CC_CTRL_DATA_MSB, chan.cc[CC_CTRL_DATA_MSB]);
+
+			if (chan.isSet(CC_CTRL_DATA_LSB))
+				fluid.synth_cc(synth, i, CC_CTRL_DATA_LSB, chan.cc[CC_CTRL_DATA_LSB]);
+
+			/* After bank select */
+			if (chan.prog >= 0)
+				fluid.synth_program_change(synth, i, chan.prog);
+
+			if (chan.pitchBend >= 0)
+				fluid.synth_pitch_bend(synth, i, chan.pitchBend);
+
+			if (chan.pressure >= 0)
+				fluid.synth_channel_pressure(synth, i, chan.pressure);
+		}
+
+		updatePlaybackSpeed(state.bpm);
 	}
 
+	/* Index of the first event at or after 'pos' */
+	size_t eventIndexAt(uint32_t pos) const
+	{
+		TimedEvent key;
+		key.pos = pos;
+
+		return std::lower_bound(events.begin(), events.end(), key) - events.begin();
+	}
 
 	void updatePlaybackSpeed(uint32_t bpm)
 	{
@@ -749,7 +936,7 @@ struct MidiSource : ALDataSource, MidiReadHandler
 		if (midiType != 0 && midiType != 1)
 			throw Exception(Exception::MKXPError, "Midi: Type 2 not supported");
 
-		tracks.resize(trackCount);
+		this->trackCount = trackCount;
 
 		// SMTP unhandled
 		if (division & 0x8000)
@@ -765,113 +952,82 @@ struct MidiSource : ALDataSource, MidiReadHandler
 
 	void onMidiEvent(const MidiEvent &e, uint32_t absDelta)
 	{
-		assert(curTrack >= 0 && curTrack < (int16_t) tracks.size());
+		assert(curTrack >= 0 && curTrack < trackCount);
 
-		Track &track = tracks[curTrack];
+		TimedEvent te;
+		te.pos = absDelta;
+		te.e = e;
 
-		track.appendEvent(e);
-		volReset.handleEvent(e, track);
-		expReset.handleEvent(e, track);
+		events.push_back(te);
+		volReset.handleEvent(te, events);
+		expReset.handleEvent(te, events);
 
 		if (e.type == CC && e.e.cc.ctrl == CC_CTRL_LOOP)
 			loopDelta = absDelta;
 	}
 
-	/* ALDataSource */
-	Status fillBuffer(AL::Buffer::ID buf)
+	/* Synthesizes the next buffer's worth of ticks into 'synthBuf',
+	 * noting where the song wraps around to its loop point if asked.
+	 * Returns false once the song has ended */
+	bool synthesize(std::vector<uint32_t> *wraps)
 	{
-		/* In case there is no currently scheduled one */
-		for (size_t i = 0; i < tracks.size(); ++i)
-			tracks[i].scheduleEvent(looped);
-
 		size_t remTicks = BUF_TICKS;
 
 		/* Iterate until all ticks that fit into the buffer
 		 * have been rendered */
 		while (remTicks > 0)
 		{
-			/* Check for events that have to be activated now, activate them,
-			 * and schedule new ones if the queue isn't empty */
-			for (size_t i = 0; i < tracks.size(); ++i)
-			{
-				Track &track = tracks[i];
+			/* Activate all events that are due by now */
+			while (cursor < events.size() && events[cursor].pos <= curPos)
+				activateEvent(events[cursor++].e);
 
-				/* We have to loop and ensure that the final scheduled
-				 * event lies in the future, as multiple events might
-				 * have to be activated at once */
-				while (true)
+			if (cursor == events.size() && !atEnd)
+			{
+				if (!looped || length == 0)
 				{
-					if (!track.valid || track.remDeltas > 0)
-						break;
-
-					int32_t prevOffset = track.remDeltas;
-
-					activateEvent(track.event);
-
-					track.valid = false;
-					track.scheduleEvent(looped);
+					/* Let the remaining notes ring out */
+					atEnd = true;
+				}
+				else
+				{
+					if (wraps)
+						wraps->push_back((BUF_TICKS - remTicks) * TICK_FRAMES);
 
-					/* Negative deltas from the previous event have to
-					 * be carried over into the next to stay in sync */
-					if (prevOffset < 0)
-						track.remDeltas += prevOffset;
+					curPos = loopDelta + (curPos - length);
+					cursor = loopI;
 
-					/* Ensure it lies in the future */
-					if (track.remDeltas > 0)
-						break;
+					continue;
 				}
 			}
 
-			size_t nextEvent = (size_t) -1;
-			bool allInvalid = true;
+			size_t genTicks = remTicks;
 
-			/* Search all tracks for the temporally nearest event */
-			for (size_t i = 0; i < tracks.size(); ++i)
+			if (!atEnd)
 			{
-				Track &track = tracks[i];
-
-				if (!track.valid)
-					continue;
-
-				allInvalid = false;
-
-				uint32_t remDelta = track.remDeltas / playbackSpeed;
-
-				/* We need to render at least one tick regardless to
-				 * avoid an endless loop of waiting for the next event
-				 * to become current */
-				if (remDelta < nextEvent)
-					nextEvent = std::max<uint32_t>(remDelta, 1);
+				/* Render up to the next event, but at least one tick
+				 * to avoid waiting for it to become current forever */
+				double untilNext = (events[cursor].pos - curPos) / playbackSpeed;
+				genTicks = std::min<size_t>(remTicks, std::max(ceil(untilNext), 1.0));
 			}
 
-			/* Calculate amount of ticks we'll render next */
-			size_t genTicks = allInvalid ? remTicks : std::min(remTicks, nextEvent);
-
-			if (genTicks == 0)
-				continue;
-
 			renderTicks(genTicks, BUF_TICKS - remTicks);
 			remTicks -= genTicks;
 
-			float genDeltas = (genTicks * playbackSpeed) + genDeltasCarry;
+			curPos += genTicks * playbackSpeed;
+		}
 
-			float intDeltas;
-			genDeltasCarry = modff(genDeltas, &intDeltas);
+		return !atEnd;
+	}
 
-			/* Substract integer part of consumed deltas while carrying
-			 * over the fractional amount into the next iteration */
-			for (size_t i = 0; i < tracks.size(); ++i)
-				if (tracks[i].valid)
-					tracks[i].remDeltas -= intDeltas;
-		}
+	/* ALDataSource */
+	Status fillBuffer(AL::Buffer::ID buf)
+	{
+		bool more = synthesize(0);
 
 		/* Fill AL buffer */
 		AL::Buffer::uploadData(buf, AL_FORMAT_STEREO16, synthBuf, sizeof(synthBuf), freq);
 
-		if (tracks[longestI].atEnd)
-			return EndOfStream;
-
-		return NoError;
+		return more ? NoError : EndOfStream;
 	}
 
 	int sampleRate()
@@ -879,19 +1035,45 @@ struct MidiSource : ALDataSource, MidiReadHandler
 		return freq;
 	}
 
-	/* Midi sources cannot seek, and so always reset to beginning */
-	void seekToOffset(float)
+	/* Seeking restores the synth state from the closest snapshot
+	 * before the target and the state changes in between; notes
+	 * that would still be held at the target are not picked up */
+	void seekToOffset(float seconds)
 	{
-		/* Reset synth */
-		fluid.synth_system_reset(synth);
+		const std::vector<Snapshot> *snaps = &snapshots;
+		size_t first = 0;
+		double pos = 0;
 
-		/* Reset runtime variables */
-		genDeltasCarry = 0;
-		updatePlaybackSpeed(DEFAULT_BPM);
+		double songSecs = tempoMap.secondsAt(length);
+
+		if (seconds > 0 && seconds < songSecs)
+		{
+			pos = tempoMap.positionAt(seconds);
+		}
+		else if (seconds >= songSecs && !loopSnapshots.empty())
+		{
+			double loopSecs = loopTempoMap.secondsAt(length);
+			pos = loopTempoMap.positionAt(fmod(seconds - songSecs, loopSecs));
+
+			snaps = &loopSnapshots;
+			first = loopI;
+		}
+
+		/* Events right at the target are played once resumed */
+		size_t target = std::max(eventIndexAt(ceil(pos)), first);
+		size_t snapI = std::min((target - first) / SNAPSHOT_EVENTS, snaps->size() - 1);
+		const Snapshot &snap = (*snaps)[snapI];
 
-		/* Reset tracks */
-		for (size_t i = 0; i < tracks.size(); ++i)
-			tracks[i].reset();
+		SynthState state = snap.state;
+
+		for (size_t i = snap.index; i < target; ++i)
+			state.apply(events[i].e);
+
+		restoreState(state);
+
+		cursor = target;
+		curPos = pos;
+		atEnd = false;
 	}
 
 	uint32_t loopStartFrames() { return 0; }
@@ -903,10 +1085,51 @@ struct MidiSource : ALDataSource, MidiReadHandler
 
 		return true;
 	}
+
+	/* MidiRenderer */
+	bool renderBlock(int16_t *buf, std::vector<uint32_t> &wraps)
+	{
+		bool more = synthesize(&wraps);
+		memcpy(buf, synthBuf, sizeof(synthBuf));
+
+		return more;
+	}
 };
 
 ALDataSource *createMidiSource(SDL_RWops &ops,
                                bool looped)
 {
-	return new MidiSource(ops, looped);
+	/* Midi files are read in whole up front */
+	size_t dataLen = SDL_RWsize(&ops);
+	std::vector<uint8_t> data(dataLen);
+
+	size_t read = SDL_RWread(&ops, &data[0], 1, dataLen);
+	SDL_RWclose(&ops);
+
+	if (read < dataLen)
+		throw Exception(Exception::MKXPError, "Reading midi data failed");
+
+	MidiCache *cache = shState->midiState().renderCache();
+
+	if (cache)
+	{
+		ALDataSource *cached = cache->open(data, looped);
+
+		if (cached)
+			return cached;
+	}
+
+	return new MidiSource(data, looped);
+}
+
+ALDataSource *createLiveMidiSource(const std::vector<uint8_t> &data,
+                                   bool looped)
+{
+	return new MidiSource(data, looped);
+}
+
+MidiRenderer *createMidiRenderer(const std::vector<uint8_t> &data,
+                                 bool looped)
+{
+	return new MidiSource(data, looped);
 }
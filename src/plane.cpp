@@ -44,12 +44,18 @@ static float fwrap(float value, float range)
 
 struct PlanePrivate
 {
+	Plane *self;
+
 	Bitmap *bitmap;
+	sigc::connection bitmapCon;
+	sigc::connection bitmapDispCon;
 
 	NormValue opacity;
 	BlendType blendType;
 	Color *color;
 	Tone *tone;
+	sigc::connection colorCon;
+	sigc::connection toneCon;
 
 	int ox, oy;
 	float zoomX, zoomY;
@@ -64,8 +70,9 @@ struct PlanePrivate
 
 	sigc::connection prepareCon;
 
-	PlanePrivate()
-	    : bitmap(0),
+	PlanePrivate(Plane *self)
+	    : self(self),
+	      bitmap(0),
 	      opacity(255),
 	      blendType(BlendNormal),
 	      color(&tmp.color),
@@ -77,14 +84,50 @@ struct PlanePrivate
 		prepareCon = shState->prepareDraw.connect
 		        (sigc::mem_fun(this, &PlanePrivate::prepare));
 
+		updateEffectCons();
+
 		qArray.resize(1);
 	}
 
 	~PlanePrivate()
 	{
+		bitmapCon.disconnect();
+		bitmapDispCon.disconnect();
+		colorCon.disconnect();
+		toneCon.disconnect();
 		prepareCon.disconnect();
 	}
 
+	void markDirty()
+	{
+		self->markSceneDirty();
+	}
+
+	void updateEffectCons()
+	{
+		colorCon.disconnect();
+		colorCon = color->valueChanged.connect
+		        (sigc::mem_fun(this, &PlanePrivate::markDirty));
+
+		toneCon.disconnect();
+		toneCon = tone->valueChanged.connect
+		        (sigc::mem_fun(this, &PlanePrivate::markDirty));
+	}
+
+	void updateBitmapCons()
+	{
+		bitmapCon.disconnect();
+		bitmapDispCon.disconnect();
+
+		if (!bitmap)
+			return;
+
+		bitmapCon = bitmap->modified.connect
+		        (sigc::mem_fun(this, &PlanePrivate::markDirty));
+		bitmapDispCon = bitmap->wasDisposed.connect
+		        (sigc::mem_fun(this, &PlanePrivate::markDirty));
+	}
+
 	void updateQuadSource()
 	{
 		if (gl.npot_repeat)
@@ -149,7 +192,7 @@ struct PlanePrivate
 Plane::Plane(Viewport *viewport)
     : ViewportElement(viewport)
 {
-	p = new PlanePrivate();
+	p = new PlanePrivate(this);
 
 	onGeometryChange(scene->getGeometry());
 }
@@ -161,7 +204,8 @@ DEF_ATTR_RD_SIMPLE(Plane, ZoomX,     float,   p->zoomX)
 DEF_ATTR_RD_SIMPLE(Plane, ZoomY,     float,   p->zoomY)
 DEF_ATTR_RD_SIMPLE(Plane, BlendType, int,     p->blendType)
 
-DEF_ATTR_SIMPLE(Plane, Opacity,   int,     p->opacity)
+DEF_ATTR_RD_SIMPLE(Plane, Opacity,   int,     p->opacity)
+
 DEF_ATTR_SIMPLE(Plane, Color,     Color&, *p->color)
 DEF_ATTR_SIMPLE(Plane, Tone,      Tone&,  *p->tone)
 
@@ -174,7 +218,12 @@ void Plane::setBitmap(Bitmap *value)
 {
 	guardDisposed();
 
+	if (p->bitmap == value)
+		return;
+
 	p->bitmap = value;
+	p->updateBitmapCons();
+	markSceneDirty();
 
 	if (!value)
 		return;
@@ -182,6 +231,17 @@ void Plane::setBitmap(Bitmap *value)
 	value->ensureNonMega();
 }
 
+void Plane::setOpacity(int value)
+{
+	guardDisposed();
+
+	if (p->opacity == value)
+		return;
+
+	p->opacity = value;
+	markSceneDirty();
+}
+
 void Plane::setOX(int value)
 {
 	guardDisposed();
@@ -191,6 +251,7 @@ void Plane::setOX(int value)
 
 	p->ox = value;
 	p->quadSourceDirty = true;
+	markSceneDirty();
 }
 
 void Plane::setOY(int value)
@@ -202,6 +263,7 @@ void Plane::setOY(int value)
 
 	p->oy = value;
 	p->quadSourceDirty = true;
+	markSceneDirty();
 }
 
 void Plane::setZoomX(float value)
@@ -213,6 +275,7 @@ void Plane::setZoomX(float value)
 
 	p->zoomX = value;
 	p->quadSourceDirty = true;
+	markSceneDirty();
 }
 
 void Plane::setZoomY(float value)
@@ -224,31 +287,42 @@ void Plane::setZoomY(float value)
 
 	p->zoomY = value;
 	p->quadSourceDirty = true;
+	markSceneDirty();
 }
 
 void Plane::setBlendType(int value)
 {
 	guardDisposed();
 
+	BlendType type;
+
 	switch (value)
 	{
 	default :
 	case BlendNormal :
-		p->blendType = BlendNormal;
-		return;
+		type = BlendNormal;
+		break;
 	case BlendAddition :
-		p->blendType = BlendAddition;
-		return;
+		type = BlendAddition;
+		break;
 	case BlendSubstraction :
-		p->blendType = BlendSubstraction;
-		return;
+		type = BlendSubstraction;
+		break;
 	}
+
+	if (p->blendType == type)
+		return;
+
+	p->blendType = type;
+	markSceneDirty();
 }
 
 void Plane::initDynAttribs()
 {
 	p->color = new Color;
 	p->tone = new Tone;
+
+	p->updateEffectCons();
 }
 
 void Plane::draw()
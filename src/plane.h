@@ -59,6 +59,8 @@ private:
 	const char *klassName() const { return "plane"; }
 
 	ABOUT_TO_ACCESS_DISP
+
+	friend struct PlanePrivate;
 };
 
 #endif // PLANE_H
@@ -0,0 +1,369 @@
+/*
+** readahead.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "readahead.h"
+
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+static const Uint32 SDL_RWOPS_READAHEAD = SDL_RWOPS_UNKNOWN+13;
+
+/* The buffer is split into two chunks: while the consumer reads
+ * from one, the other one is filled with the data following it */
+struct ReadAhead
+{
+	enum ChunkState
+	{
+		Free,
+		Queued,
+		Filling,
+		Ready
+	};
+
+	struct Chunk
+	{
+		std::vector<Uint8> data;
+		ChunkState state;
+		Sint64 offset;
+		size_t size;
+	};
+
+	SDL_RWops src;
+	Sint64 srcSize;
+	size_t chunkSize;
+
+	Chunk chunks[2];
+	Sint64 pos;
+
+	SDL_Thread *thread;
+	SDL_mutex *mut;
+	SDL_cond *cond;
+	bool termReq;
+
+	unsigned int stalls;
+
+	ReadAhead(const SDL_RWops &src, Sint64 srcSize, size_t chunkSize)
+	    : src(src),
+	      srcSize(srcSize),
+	      chunkSize(chunkSize),
+	      pos(0),
+	      termReq(false),
+	      stalls(0)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			chunks[i].data.resize(chunkSize);
+			chunks[i].state = Free;
+			chunks[i].offset = -1;
+			chunks[i].size = 0;
+		}
+
+		mut = SDL_CreateMutex();
+		cond = SDL_CreateCond();
+
+		thread = createSDLThread
+			<ReadAhead, &ReadAhead::fillChunks>(this, "readahead");
+	}
+
+	~ReadAhead()
+	{
+		SDL_LockMutex(mut);
+		termReq = true;
+		SDL_CondBroadcast(cond);
+		SDL_UnlockMutex(mut);
+
+		SDL_WaitThread(thread, 0);
+
+		SDL_DestroyCond(cond);
+		SDL_DestroyMutex(mut);
+
+		SDL_RWclose(&src);
+	}
+
+	/* Chunk holding (or about to hold) the data at 'offset' */
+	Chunk *chunkFor(Sint64 offset)
+	{
+		for (int i = 0; i < 2; ++i)
+			if (chunks[i].state != Free && chunks[i].offset == offset)
+				return &chunks[i];
+
+		return 0;
+	}
+
+	/* Queues up 'offset' in a chunk other than 'keep'. Must
+	 * be called with the mutex held */
+	Chunk *queue(Sint64 offset, Chunk *keep)
+	{
+		if (offset >= srcSize)
+			return 0;
+
+		Chunk *chunk = chunkFor(offset);
+
+		if (chunk)
+			return chunk;
+
+		for (int i = 0; i < 2; ++i)
+		{
+			Chunk &c = chunks[i];
+
+			/* The chunk being filled is left alone,
+			 * its data will just be thrown away later */
+			if (&c == keep || c.state == Filling)
+				continue;
+
+			c.state = Queued;
+			c.offset = offset;
+			SDL_CondBroadcast(cond);
+
+			return &c;
+		}
+
+		return 0;
+	}
+
+	size_t read(Uint8 *dst, size_t len)
+	{
+		size_t done = 0;
+
+		SDL_LockMutex(mut);
+
+		while (done < len && pos < srcSize)
+		{
+			Sint64 offset = pos - (pos % chunkSize);
+			Chunk *chunk = chunkFor(offset);
+
+			if (!chunk)
+				chunk = queue(offset, 0);
+			else if (chunk->state != Ready)
+				++stalls;
+
+			while (chunk->state != Ready && chunk->offset == offset)
+				SDL_CondWait(cond, mut);
+
+			/* The chunk was reassigned meanwhile, start over */
+			if (chunk->offset != offset)
+				continue;
+
+			/* Short read from the source, treat as end of data */
+			if (pos >= chunk->offset + (Sint64) chunk->size)
+				break;
+
+			size_t chunkPos = pos - chunk->offset;
+			size_t count = std::min(len - done, chunk->size - chunkPos);
+
+			memcpy(dst + done, &chunk->data[chunkPos], count);
+			done += count;
+			pos += count;
+
+			/* Keep the next chunk coming */
+			queue(offset + chunkSize, chunk);
+		}
+
+		SDL_UnlockMutex(mut);
+
+		return done;
+	}
+
+	Sint64 seek(Sint64 offset, int whence)
+	{
+		Sint64 base;
+
+		switch (whence)
+		{
+		default:
+		case RW_SEEK_SET :
+			base = 0;
+			break;
+		case RW_SEEK_CUR :
+			base = pos;
+			break;
+		case RW_SEEK_END :
+			base = srcSize;
+			break;
+		}
+
+		if (base + offset < 0)
+			return -1;
+
+		SDL_LockMutex(mut);
+		pos = std::min(base + offset, srcSize);
+		SDL_UnlockMutex(mut);
+
+		return pos;
+	}
+
+	/* thread func */
+	void fillChunks()
+	{
+		SDL_LockMutex(mut);
+
+		while (!termReq)
+		{
+			Chunk *chunk = 0;
+
+			for (int i = 0; i < 2 && !chunk; ++i)
+				if (chunks[i].state == Queued)
+					chunk = &chunks[i];
+
+			if (!chunk)
+			{
+				SDL_CondWait(cond, mut);
+				continue;
+			}
+
+			chunk->state = Filling;
+			Sint64 offset = chunk->offset;
+
+			SDL_UnlockMutex(mut);
+
+			/* Only this thread touches the source and
+			 * a chunk's data while it is being filled */
+			size_t size = 0;
+
+			if (SDL_RWseek(&src, offset, RW_SEEK_SET) == offset)
+				size = SDL_RWread(&src, &chunk->data[0], 1, chunkSize);
+
+			SDL_LockMutex(mut);
+
+			chunk->state = Ready;
+			chunk->size = size;
+
+			SDL_CondBroadcast(cond);
+		}
+
+		SDL_UnlockMutex(mut);
+	}
+};
+
+static ReadAhead *getReadAhead(SDL_RWops *ops)
+{
+	return static_cast<ReadAhead*>(ops->hidden.unknown.data1);
+}
+
+static Sint64 SDL_RWopsReadAheadSize(SDL_RWops *ops)
+{
+	ReadAhead *ra = getReadAhead(ops);
+
+	if (!ra)
+		return -1;
+
+	return ra->srcSize;
+}
+
+static Sint64 SDL_RWopsReadAheadSeek(SDL_RWops *ops, Sint64 offset, int whence)
+{
+	ReadAhead *ra = getReadAhead(ops);
+
+	if (!ra)
+		return -1;
+
+	return ra->seek(offset, whence);
+}
+
+static size_t SDL_RWopsReadAheadRead(SDL_RWops *ops, void *buffer, size_t size, size_t maxnum)
+{
+	ReadAhead *ra = getReadAhead(ops);
+
+	if (!ra || size == 0)
+		return 0;
+
+	return ra->read(static_cast<Uint8*>(buffer), size*maxnum) / size;
+}
+
+static size_t SDL_RWopsReadAheadWrite(SDL_RWops *, const void *, size_t, size_t)
+{
+	return 0;
+}
+
+static int SDL_RWopsReadAheadClose(SDL_RWops *ops)
+{
+	ReadAhead *ra = getReadAhead(ops);
+
+	if (!ra)
+		return -1;
+
+	delete ra;
+	ops->hidden.unknown.data1 = 0;
+
+	return 0;
+}
+
+static int SDL_RWopsReadAheadCloseFree(SDL_RWops *ops)
+{
+	int result = SDL_RWopsReadAheadClose(ops);
+
+	SDL_FreeRW(ops);
+
+	return result;
+}
+
+void initReadAheadOps(SDL_RWops &ops,
+                      const SDL_RWops &src,
+                      size_t readAhead,
+                      bool freeOnClose)
+{
+	SDL_RWops srcCopy = src;
+	Sint64 srcSize = SDL_RWsize(&srcCopy);
+
+	if (srcSize < 0 || readAhead == 0)
+	{
+		ops = src;
+		return;
+	}
+
+	size_t chunkSize = std::max<size_t>(readAhead / 2, 4096);
+
+	ops.size  = SDL_RWopsReadAheadSize;
+	ops.seek  = SDL_RWopsReadAheadSeek;
+	ops.read  = SDL_RWopsReadAheadRead;
+	ops.write = SDL_RWopsReadAheadWrite;
+
+	if (freeOnClose)
+		ops.close = SDL_RWopsReadAheadCloseFree;
+	else
+		ops.close = SDL_RWopsReadAheadClose;
+
+	ops.type = SDL_RWOPS_READAHEAD;
+	ops.hidden.unknown.data1 = new ReadAhead(src, srcSize, chunkSize);
+}
+
+unsigned int readAheadStalls(SDL_RWops &ops)
+{
+	if (ops.type != SDL_RWOPS_READAHEAD)
+		return 0;
+
+	ReadAhead *ra = getReadAhead(&ops);
+
+	if (!ra)
+		return 0;
+
+	SDL_LockMutex(ra->mut);
+	unsigned int stalls = ra->stalls;
+	SDL_UnlockMutex(ra->mut);
+
+	return stalls;
+}
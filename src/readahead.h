@@ -0,0 +1,44 @@
+/*
+** readahead.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <SDL_rwops.h>
+#include <stddef.h>
+
+/* Wraps 'src' into 'ops', with a background thread reading
+ * up to 'readAhead' bytes ahead of the consumer, so that
+ * sequential reads are served from memory. 'ops' takes over
+ * ownership of 'src' and closes it when it is closed itself.
+ * If 'src' has no known size, it is used unbuffered */
+void initReadAheadOps(SDL_RWops &ops,
+                      const SDL_RWops &src,
+                      size_t readAhead,
+                      bool freeOnClose = false);
+
+/* Number of reads that had to wait on data which was
+ * already being read ahead, ie. the prefetching didn't
+ * keep up. Waits after opening / seeking aren't counted.
+ * Returns 0 for ops not created by 'initReadAheadOps()' */
+unsigned int readAheadStalls(SDL_RWops &ops);
+
+#endif // READAHEAD_H
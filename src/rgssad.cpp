@@ -21,9 +21,32 @@
 
 #include "rgssad.h"
 #include "boost-hash.h"
+#include "debugwriter.h"
+
+#include <SDL_platform.h>
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef __WINDOWS__
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 struct RGSS_entryData
 {
@@ -37,26 +60,276 @@ struct RGSS_entryHandle
 	RGSS_entryData data;
 	uint32_t currentMagic;
 	uint64_t currentOffset;
+
+	/* Either the entry is served straight out of the
+	 * archive mapping, or through its own archive io */
+	const uint8_t *mapped;
 	PHYSFS_Io *io;
 
-	RGSS_entryHandle(const RGSS_entryData &data, PHYSFS_Io *archIo)
+	RGSS_entryHandle(const RGSS_entryData &data, PHYSFS_Io *archIo,
+	                 const uint8_t *mapBase)
 	    : data(data),
 	      currentMagic(data.startMagic),
-	      currentOffset(0)
+	      currentOffset(0),
+	      mapped(0),
+	      io(0)
 	{
-		io = archIo->duplicate(archIo);
+		if (mapBase)
+			mapped = mapBase + data.offset;
+		else
+			io = archIo->duplicate(archIo);
+	}
+
+	RGSS_entryHandle(const RGSS_entryHandle &other)
+	    : data(other.data),
+	      currentMagic(other.currentMagic),
+	      currentOffset(other.currentOffset),
+	      mapped(other.mapped),
+	      io(0)
+	{
+		if (other.io)
+		{
+			io = other.io->duplicate(other.io);
+			io->seek(io, data.offset + currentOffset);
+		}
 	}
 
 	~RGSS_entryHandle()
 	{
-		io->destroy(io);
+		if (io)
+			io->destroy(io);
+	}
+
+	/* Reads raw (still encrypted) bytes at 'pos' relative
+	 * to the entry start. The io is expected to be positioned
+	 * there already */
+	void readRaw(void *dest, uint64_t &pos, uint64_t len)
+	{
+		if (mapped)
+			memcpy(dest, mapped + pos, len);
+		else
+			io->read(io, dest, len);
+
+		pos += len;
+	}
+
+private:
+	RGSS_entryHandle &operator=(const RGSS_entryHandle &);
+};
+
+/* Read-only mapping of a whole archive file */
+struct ArchiveMapping
+{
+	const uint8_t *data;
+	uint64_t size;
+
+#ifdef __WINDOWS__
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+	ArchiveMapping()
+	    : data(0),
+	      size(0)
+	{}
+
+	~ArchiveMapping()
+	{
+		unmap();
 	}
+
+	/* An 'expectedSize' of 0 accepts any non-empty file */
+	bool map(const char *path, uint64_t expectedSize = 0);
+	void unmap();
+};
+
+#ifdef __WINDOWS__
+
+bool ArchiveMapping::map(const char *path, uint64_t expectedSize)
+{
+	int wlen = MultiByteToWideChar(CP_UTF8, 0, path, -1, 0, 0);
+
+	if (wlen <= 0)
+		return false;
+
+	std::wstring wpath(wlen, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, &wpath[0], wlen);
+
+	file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+	                   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0
+	    || (expectedSize && (uint64_t) fileSize.QuadPart != expectedSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	size = fileSize.QuadPart;
+
+	return true;
+}
+
+void ArchiveMapping::unmap()
+{
+	if (!data)
+		return;
+
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	CloseHandle(file);
+
+	data = 0;
+}
+
+#else
+
+bool ArchiveMapping::map(const char *path, uint64_t expectedSize)
+{
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+
+	/* Archives nested in other archives aren't real files,
+	 * and the size check catches the path naming something else */
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0
+	    || (expectedSize && (uint64_t) st.st_size != expectedSize))
+	{
+		close(fd);
+		return false;
+	}
+
+	void *addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	/* The mapping stays valid after the descriptor is closed */
+	close(fd);
+
+	if (addr == MAP_FAILED)
+		return false;
+
+	data = static_cast<const uint8_t*>(addr);
+	size = st.st_size;
+
+	return true;
+}
+
+void ArchiveMapping::unmap()
+{
+	if (!data)
+		return;
+
+	munmap(const_cast<uint8_t*>(data), size);
+
+	data = 0;
+}
+
+#endif
+
+static bool mapArchives = false;
+static std::string indexCacheDir;
+
+void RGSS_setMapArchives(bool enabled)
+{
+	mapArchives = enabled;
+}
+
+void RGSS_setIndexCacheDir(const char *dir)
+{
+	indexCacheDir = dir ? dir : "";
+}
+
+/* Io reading out of an archive mapping, so the entry
+ * table can be parsed without a syscall per field */
+struct MapParseIo
+{
+	PHYSFS_Io io;
+	const ArchiveMapping &mapping;
+	uint64_t pos;
+
+	MapParseIo(const ArchiveMapping &mapping, uint64_t pos);
 };
 
+static PHYSFS_sint64
+MAP_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
+{
+	MapParseIo *mio = static_cast<MapParseIo*>(self->opaque);
+
+	uint64_t toRead = std::min<uint64_t>(mio->mapping.size - mio->pos, len);
+	memcpy(buffer, mio->mapping.data + mio->pos, toRead);
+	mio->pos += toRead;
+
+	return toRead;
+}
+
+static int
+MAP_ioSeek(PHYSFS_Io *self, PHYSFS_uint64 offset)
+{
+	MapParseIo *mio = static_cast<MapParseIo*>(self->opaque);
+
+	if (offset > mio->mapping.size)
+		return 0;
+
+	mio->pos = offset;
+
+	return 1;
+}
+
+static PHYSFS_sint64
+MAP_ioTell(PHYSFS_Io *self)
+{
+	return static_cast<MapParseIo*>(self->opaque)->pos;
+}
+
+static PHYSFS_sint64
+MAP_ioLength(PHYSFS_Io *self)
+{
+	return static_cast<MapParseIo*>(self->opaque)->mapping.size;
+}
+
+MapParseIo::MapParseIo(const ArchiveMapping &mapping, uint64_t pos)
+    : mapping(mapping),
+      pos(pos)
+{
+	memset(&io, 0, sizeof(io));
+
+	io.opaque = this;
+	io.read   = MAP_ioRead;
+	io.seek   = MAP_ioSeek;
+	io.tell   = MAP_ioTell;
+	io.length = MAP_ioLength;
+}
+
 struct RGSS_archiveData
 {
 	PHYSFS_Io *archiveIo;
 
+	ArchiveMapping mapping;
+
 	/* Maps: file path
 	 * to:   entry data */
 	BoostHash<std::string, RGSS_entryData> entryHash;
@@ -98,6 +371,136 @@ advanceMagic(uint32_t &magic)
 	return old;
 }
 
+/* The magic sequence is an affine LCG (m' = m * 7 + 3, mod 2^32),
+ * so advancing it by n steps is again an affine map m' = m * a + c.
+ * This lets us jump ahead in O(log n) and generate several words
+ * of the key stream independently of each other */
+struct MagicStep
+{
+	uint32_t a, c;
+
+	MagicStep(uint32_t a = 1, uint32_t c = 0)
+	    : a(a), c(c)
+	{}
+
+	/* Applies 'o', then this step */
+	MagicStep after(const MagicStep &o) const
+	{
+		return MagicStep(a * o.a, a * o.c + c);
+	}
+
+	uint32_t apply(uint32_t magic) const
+	{
+		return magic * a + c;
+	}
+};
+
+static MagicStep
+magicStepN(uint64_t n)
+{
+	MagicStep result;
+	MagicStep base(7, 3);
+
+	for (; n > 0; n >>= 1)
+	{
+		if (n & 1)
+			result = base.after(result);
+
+		base = base.after(base);
+	}
+
+	return result;
+}
+
+#if !defined(__AVX2__) && defined(__SSE2__)
+/* SSE2 lacks a packed 32 bit low multiply */
+static inline __m128i
+mullo32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+/* Xors 'count' dwords with the key stream starting at 'magic',
+ * and leaves 'magic' advanced past them */
+static void
+xorMagic(uint32_t *buffer, uint64_t count, uint32_t &magic)
+{
+	uint64_t i = 0;
+
+#if defined(__AVX2__)
+	if (count >= 8)
+	{
+		uint32_t m[8];
+		m[0] = magic;
+		for (int j = 1; j < 8; ++j)
+			m[j] = m[j-1] * 7 + 3;
+
+		const MagicStep step = magicStepN(8);
+		const __m256i a = _mm256_set1_epi32(step.a);
+		const __m256i c = _mm256_set1_epi32(step.c);
+		__m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m));
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i *p = reinterpret_cast<__m256i*>(&buffer[i]);
+			_mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), lanes));
+			lanes = _mm256_add_epi32(_mm256_mullo_epi32(lanes, a), c);
+		}
+
+		magic = _mm_cvtsi128_si32(_mm256_castsi256_si128(lanes));
+	}
+#elif defined(__SSE2__)
+	if (count >= 4)
+	{
+		uint32_t m1 = magic * 7 + 3;
+		uint32_t m2 = m1 * 7 + 3;
+		uint32_t m3 = m2 * 7 + 3;
+
+		const MagicStep step = magicStepN(4);
+		const __m128i a = _mm_set1_epi32(step.a);
+		const __m128i c = _mm_set1_epi32(step.c);
+		__m128i lanes = _mm_set_epi32(m3, m2, m1, magic);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i *p = reinterpret_cast<__m128i*>(&buffer[i]);
+			_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), lanes));
+			lanes = _mm_add_epi32(mullo32(lanes, a), c);
+		}
+
+		magic = _mm_cvtsi128_si32(lanes);
+	}
+#else
+	if (count >= 4)
+	{
+		/* Four independent chains instead of one serial one */
+		uint32_t m[4];
+		m[0] = magic;
+		for (int j = 1; j < 4; ++j)
+			m[j] = m[j-1] * 7 + 3;
+
+		const MagicStep step = magicStepN(4);
+
+		for (; i + 4 <= count; i += 4)
+			for (int j = 0; j < 4; ++j)
+			{
+				buffer[i+j] ^= m[j];
+				m[j] = step.apply(m[j]);
+			}
+
+		magic = m[0];
+	}
+#endif
+
+	for (; i < count; ++i)
+		buffer[i] ^= advanceMagic(magic);
+}
+
 static PHYSFS_sint64
 RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 {
@@ -108,7 +511,11 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 	uint64_t toRead = std::min<uint64_t>(entry->data.size - entry->currentOffset, len);
 	uint64_t offs = entry->currentOffset;
 
-	io->seek(io, entry->data.offset + offs);
+	/* Raw read position, relative to the entry start */
+	uint64_t pos = offs;
+
+	if (io)
+		io->seek(io, entry->data.offset + offs);
 
 	/* We divide up the bytes to be read in 3 categories:
 	 *
@@ -133,11 +540,11 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 	if (preAlign == 4)
 		preAlign = 0;
 	else
-		preAlign = std::min<uint64_t>(preAlign, len);
+		preAlign = std::min<uint64_t>(preAlign, toRead);
 
-	uint8_t postAlign = (len > preAlign) ? (offs + len) % 4 : 0;
+	uint8_t postAlign = (toRead > preAlign) ? (offs + toRead) % 4 : 0;
 
-	uint64_t align = len - (preAlign + postAlign);
+	uint64_t align = toRead - (preAlign + postAlign);
 
 	/* Byte buffer pointer */
 	uint8_t *bBufferP = static_cast<uint8_t*>(buffer);
@@ -145,7 +552,7 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 	if (preAlign > 0)
 	{
 		uint32_t dword;
-		io->read(io, &dword, preAlign);
+		entry->readRaw(&dword, pos, preAlign);
 
 		/* Need to align the bytes with the
 		 * magic before xoring */
@@ -170,11 +577,10 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 		uint32_t *dwBufferP = reinterpret_cast<uint32_t*>(bBufferP);
 
 		/* Read aligned dwords in one go */
-		io->read(io, bBufferP, align);
+		entry->readRaw(bBufferP, pos, align);
 
 		/* Then xor them */
-		for (uint64_t i = 0; i < (align / 4); ++i)
-			dwBufferP[i] ^= advanceMagic(entry->currentMagic);
+		xorMagic(dwBufferP, align / 4, entry->currentMagic);
 
 		bBufferP += align;
 	}
@@ -182,7 +588,7 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 	if (postAlign > 0)
 	{
 		uint32_t dword;
-		io->read(io, &dword, postAlign);
+		entry->readRaw(&dword, pos, postAlign);
 
 		/* Bytes are already aligned with magic */
 		dword ^= entry->currentMagic;
@@ -217,11 +623,12 @@ RGSS_ioSeek(PHYSFS_Io *self, PHYSFS_uint64 offset)
 	uint64_t targetDword  = offset / 4;
 	uint64_t dwordsSought = targetDword - currentDword;
 
-	for (uint64_t i = 0; i < dwordsSought; ++i)
-		advanceMagic(entry->currentMagic);
+	entry->currentMagic = magicStepN(dwordsSought).apply(entry->currentMagic);
 
 	entry->currentOffset = offset;
-	entry->io->seek(entry->io, entry->data.offset + entry->currentOffset);
+
+	if (entry->io)
+		entry->io->seek(entry->io, entry->data.offset + entry->currentOffset);
 
 	return 1;
 }
@@ -313,6 +720,245 @@ processDirectories(RGSS_archiveData *data, BoostSet<std::string> &topLevel,
 		}
 }
 
+static void
+mapArchive(RGSS_archiveData *data, const char *name)
+{
+	if (!mapArchives || !name)
+		return;
+
+	PHYSFS_Io *io = data->archiveIo;
+	PHYSFS_sint64 length = io->length(io);
+
+	if (length <= 0)
+		return;
+
+	if (!data->mapping.map(name, length))
+		Debug() << "Could not map archive" << name << "into memory";
+}
+
+/* Parsed entry tables are cached in the user data directory,
+ * so big archives don't have to be decrypted entry by entry
+ * on every launch. A cache file is only used if the archive's
+ * size, modification time and a hash over its start (which
+ * holds the beginning of the entry table) still match */
+#define INDEX_CACHE_MAGIC "MKXPIDX"
+#define INDEX_CACHE_VER 1
+#define INDEX_CACHE_HASHED_BYTES 0x10000
+
+struct IndexCacheHeader
+{
+	char magic[8];
+	uint32_t formVer;
+	uint32_t entryCount;
+	uint64_t archiveSize;
+	int64_t archiveMtime;
+	uint64_t archiveHash;
+};
+
+/* Followed by 'nameLen' name bytes, padded to 8 */
+struct IndexCacheEntry
+{
+	int64_t offset;
+	uint64_t size;
+	uint32_t startMagic;
+	uint32_t nameLen;
+};
+
+struct IndexCacheKey
+{
+	std::string path;
+	uint64_t archiveSize;
+	int64_t archiveMtime;
+	uint64_t archiveHash;
+};
+
+static uint64_t
+fnv1a(const void *data, size_t size, uint64_t hash = 0xCBF29CE484222325ULL)
+{
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+static size_t
+indexCacheEntrySize(uint32_t nameLen)
+{
+	return (sizeof(IndexCacheEntry) + nameLen + 7) & ~(size_t) 7;
+}
+
+static bool
+getIndexCacheKey(RGSS_archiveData *data, const char *name, IndexCacheKey &key)
+{
+	if (indexCacheDir.empty() || !name)
+		return false;
+
+	struct stat st;
+
+	if (stat(name, &st) < 0 || !S_ISREG(st.st_mode))
+		return false;
+
+	PHYSFS_Io *io = data->archiveIo;
+	PHYSFS_sint64 length = io->length(io);
+
+	if (length <= 0 || (uint64_t) st.st_size != (uint64_t) length)
+		return false;
+
+	key.archiveSize = length;
+	key.archiveMtime = st.st_mtime;
+
+	size_t hashed = std::min<uint64_t>(length, INDEX_CACHE_HASHED_BYTES);
+
+	if (data->mapping.data)
+	{
+		key.archiveHash = fnv1a(data->mapping.data, hashed);
+	}
+	else
+	{
+		std::vector<uint8_t> buffer(hashed);
+		PHYSFS_sint64 pos = io->tell(io);
+
+		bool ok = io->seek(io, 0) && IO_READ(io, &buffer[0], (PHYSFS_sint64) hashed);
+		io->seek(io, pos);
+
+		if (!ok)
+			return false;
+
+		key.archiveHash = fnv1a(&buffer[0], hashed);
+	}
+
+	char file[64];
+	uint64_t pathHash = fnv1a(name, strlen(name));
+	snprintf(file, sizeof(file), "archive-index-%08x%08x.mkxp",
+	         (uint32_t) (pathHash >> 32), (uint32_t) pathHash);
+
+	key.path = indexCacheDir + file;
+
+	return true;
+}
+
+static bool
+loadIndexCache(RGSS_archiveData *data, const IndexCacheKey &key)
+{
+	ArchiveMapping cache;
+
+	if (!cache.map(key.path.c_str()))
+		return false;
+
+	IndexCacheHeader hd;
+
+	if (cache.size < sizeof(hd))
+		return false;
+
+	memcpy(&hd, cache.data, sizeof(hd));
+
+	if (memcmp(hd.magic, INDEX_CACHE_MAGIC, sizeof(INDEX_CACHE_MAGIC))
+	    || hd.formVer != INDEX_CACHE_VER
+	    || hd.archiveSize != key.archiveSize
+	    || hd.archiveMtime != key.archiveMtime
+	    || hd.archiveHash != key.archiveHash)
+		return false;
+
+	/* Validate the whole table before touching the hashes,
+	 * so a truncated cache file doesn't leave a partial index */
+	uint64_t pos = sizeof(hd);
+
+	for (uint32_t i = 0; i < hd.entryCount; ++i)
+	{
+		IndexCacheEntry entry;
+
+		if (cache.size - pos < sizeof(entry))
+			return false;
+
+		memcpy(&entry, cache.data + pos, sizeof(entry));
+
+		if (entry.nameLen == 0 || entry.nameLen >= 512
+		    || cache.size - pos < indexCacheEntrySize(entry.nameLen))
+			return false;
+
+		pos += indexCacheEntrySize(entry.nameLen);
+	}
+
+	if (pos != cache.size)
+		return false;
+
+	BoostSet<std::string> &topLevel = data->dirHash[""];
+	pos = sizeof(hd);
+
+	for (uint32_t i = 0; i < hd.entryCount; ++i)
+	{
+		IndexCacheEntry entry;
+		memcpy(&entry, cache.data + pos, sizeof(entry));
+
+		char nameBuf[512];
+		memcpy(nameBuf, cache.data + pos + sizeof(entry), entry.nameLen);
+		nameBuf[entry.nameLen] = '\0';
+
+		RGSS_entryData entryData;
+		entryData.offset = entry.offset;
+		entryData.size = entry.size;
+		entryData.startMagic = entry.startMagic;
+
+		data->entryHash.insert(nameBuf, entryData);
+		processDirectories(data, topLevel, nameBuf, entry.nameLen);
+
+		pos += indexCacheEntrySize(entry.nameLen);
+	}
+
+	return true;
+}
+
+static void
+storeIndexCache(RGSS_archiveData *data, const IndexCacheKey &key)
+{
+	IndexCacheHeader hd;
+	memset(&hd, 0, sizeof(hd));
+	memcpy(hd.magic, INDEX_CACHE_MAGIC, sizeof(INDEX_CACHE_MAGIC));
+	hd.formVer = INDEX_CACHE_VER;
+	hd.entryCount = 0;
+	hd.archiveSize = key.archiveSize;
+	hd.archiveMtime = key.archiveMtime;
+	hd.archiveHash = key.archiveHash;
+
+	std::vector<uint8_t> buffer(sizeof(hd));
+
+	BoostHash<std::string, RGSS_entryData>::const_iterator iter;
+	for (iter = data->entryHash.cbegin(); iter != data->entryHash.cend(); ++iter)
+	{
+		IndexCacheEntry entry;
+		entry.offset = iter->second.offset;
+		entry.size = iter->second.size;
+		entry.startMagic = iter->second.startMagic;
+		entry.nameLen = iter->first.size();
+
+		size_t pos = buffer.size();
+		buffer.resize(pos + indexCacheEntrySize(entry.nameLen), 0);
+		memcpy(&buffer[pos], &entry, sizeof(entry));
+		memcpy(&buffer[pos + sizeof(entry)], iter->first.c_str(), entry.nameLen);
+
+		++hd.entryCount;
+	}
+
+	memcpy(&buffer[0], &hd, sizeof(hd));
+
+	FILE *f = fopen(key.path.c_str(), "wb");
+
+	if (!f)
+		return;
+
+	size_t written = fwrite(&buffer[0], 1, buffer.size(), f);
+	fclose(f);
+
+	/* A partial file would be rejected on load anyway */
+	if (written < buffer.size())
+		remove(key.path.c_str());
+}
+
 static bool
 verifyHeader(PHYSFS_Io *io, char version)
 {
@@ -331,7 +977,7 @@ verifyHeader(PHYSFS_Io *io, char version)
 }
 
 static void*
-RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite)
+RGSS_openArchive(PHYSFS_Io *io, const char *name, int forWrite)
 {
 	if (forWrite)
 		return 0;
@@ -343,6 +989,19 @@ RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite)
 	RGSS_archiveData *data = new RGSS_archiveData;
 	data->archiveIo = io;
 
+	/* Parse the entry table out of the mapping if we got one */
+	mapArchive(data, name);
+	MapParseIo mapIo(data->mapping, io->tell(io));
+
+	if (data->mapping.data)
+		io = &mapIo.io;
+
+	IndexCacheKey cacheKey;
+	bool haveCacheKey = getIndexCacheKey(data, name, cacheKey);
+
+	if (haveCacheKey && loadIndexCache(data, cacheKey))
+		return data;
+
 	uint32_t magic = RGSS_MAGIC;
 
 	/* Top level entry list */
@@ -386,6 +1045,9 @@ RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite)
 		io->seek(io, entry.offset + entry.size);
 	}
 
+	if (haveCacheKey)
+		storeIndexCache(data, cacheKey);
+
 	return data;
 }
 
@@ -416,8 +1078,20 @@ RGSS_openRead(void *opaque, const char *filename)
 	if (!data->entryHash.contains(filename))
 		return 0;
 
+	const RGSS_entryData &entryData = data->entryHash[filename];
+	const ArchiveMapping &mapping = data->mapping;
+
+	/* Fall back to the io for entries pointing past the
+	 * end of the archive, so broken ones can't overrun the mapping */
+	const uint8_t *mapBase = 0;
+
+	if (mapping.data && entryData.offset >= 0
+	    && (uint64_t) entryData.offset <= mapping.size
+	    && entryData.size <= mapping.size - entryData.offset)
+		mapBase = mapping.data;
+
 	RGSS_entryHandle *entry =
-	        new RGSS_entryHandle(data->entryHash[filename], data->archiveIo);
+	        new RGSS_entryHandle(entryData, data->archiveIo, mapBase);
 
 	PHYSFS_Io *io = PHYSFS_ALLOC(PHYSFS_Io);
 
@@ -536,7 +1210,7 @@ readUint32AndXor(PHYSFS_Io *io, uint32_t &result, uint32_t key)
 }
 
 static void*
-RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite)
+RGSS3_openArchive(PHYSFS_Io *io, const char *name, int forWrite)
 {
 	if (forWrite)
 		return 0;
@@ -555,6 +1229,18 @@ RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite)
 	RGSS_archiveData *data = new RGSS_archiveData;
 	data->archiveIo = io;
 
+	mapArchive(data, name);
+	MapParseIo mapIo(data->mapping, io->tell(io));
+
+	if (data->mapping.data)
+		io = &mapIo.io;
+
+	IndexCacheKey cacheKey;
+	bool haveCacheKey = getIndexCacheKey(data, name, cacheKey);
+
+	if (haveCacheKey && loadIndexCache(data, cacheKey))
+		return data;
+
 	/* Top level entry list */
 	BoostSet<std::string> &topLevel = data->dirHash[""];
 
@@ -608,6 +1294,9 @@ RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite)
 		return 0;
 	}
 
+	if (haveCacheKey)
+		storeIndexCache(data, cacheKey);
+
 	return data;
 }
 
@@ -28,4 +28,12 @@ extern const PHYSFS_Archiver RGSS1_Archiver;
 extern const PHYSFS_Archiver RGSS2_Archiver;
 extern const PHYSFS_Archiver RGSS3_Archiver;
 
+/* If enabled, archives opened afterwards are memory mapped
+ * (where possible) and served without per-read syscalls */
+void RGSS_setMapArchives(bool enabled);
+
+/* Directory (with trailing separator) to cache parsed
+ * archive entry tables in; null or empty disables the cache */
+void RGSS_setIndexCacheDir(const char *dir);
+
 #endif // RGSSAD_H
@@ -23,6 +23,7 @@
 #include "sharedstate.h"
 
 Scene::Scene()
+    : dirty(true)
 {}
 
 Scene::~Scene()
@@ -47,11 +48,13 @@ void Scene::insert(SceneElement &element)
 		if (element < *e)
 		{
 			elements.insertBefore(element.link, *iter);
+			markDirty();
 			return;
 		}
 	}
 
 	elements.append(element.link);
+	markDirty();
 }
 
 void Scene::insertAfter(SceneElement &element, SceneElement &after)
@@ -65,11 +68,13 @@ void Scene::insertAfter(SceneElement &element, SceneElement &after)
 		if (element < *e)
 		{
 			elements.insertBefore(element.link, *iter);
+			markDirty();
 			return;
 		}
 	}
 
 	elements.append(element.link);
+	markDirty();
 }
 
 void Scene::reinsert(SceneElement &element)
@@ -86,6 +91,13 @@ void Scene::notifyGeometryChange()
 	{
 		iter->data->onGeometryChange(geometry);
 	}
+
+	markDirty();
+}
+
+void Scene::markDirty()
+{
+	dirty = true;
 }
 
 void Scene::composite()
@@ -99,6 +111,8 @@ void Scene::composite()
 		if (e->visible)
 			e->draw();
 	}
+
+	dirty = false;
 }
 
 
@@ -158,7 +172,13 @@ void SceneElement::setVisible(bool value)
 {
 	aboutToAccess();
 
+	if (visible == value)
+		return;
+
 	visible = value;
+
+	if (scene)
+		scene->markDirty();
 }
 
 bool SceneElement::operator<(const SceneElement &o) const
@@ -197,6 +217,15 @@ void SceneElement::setSpriteY(int value)
 
 void SceneElement::unlink()
 {
-	if (scene)
-		scene->elements.remove(link);
+	if (!scene)
+		return;
+
+	markSceneDirty();
+	scene->elements.remove(link);
+}
+
+void SceneElement::markSceneDirty()
+{
+	if (scene && visible)
+		scene->markDirty();
 }
@@ -56,9 +56,17 @@ public:
 
 	virtual void composite();
 	virtual void requestViewportRender(Vec4& /*color*/, Vec4& /*flash*/, Vec4& /*tone*/) {}
+	/* Rebinds the framebuffer this scene is composited into,
+	 * for children that temporarily render elsewhere */
+	virtual void restoreRenderTarget() {}
 
 	const Geometry &getGeometry() const { return geometry; }
 
+	/* A scene is dirty if any of its elements changed
+	 * visually since it was last composited */
+	virtual void markDirty();
+	bool isDirty() const { return dirty; }
+
 protected:
 	void insert(SceneElement &element);
 	void insertAfter(SceneElement &element, SceneElement &after);
@@ -69,6 +77,7 @@ protected:
 
 	IntruList<SceneElement> elements;
 	Geometry geometry;
+	bool dirty;
 
 	friend class SceneElement;
 	friend class Window;
@@ -120,6 +129,10 @@ protected:
 	void setSpriteY(int value);
 	void unlink();
 
+	/* Call whenever a change affects how this element
+	 * is drawn; hidden elements are not reported */
+	void markSceneDirty();
+
 	IntruListLink<SceneElement> link;
 	const unsigned int creationStamp;
 	int z;
@@ -107,7 +107,7 @@ void Shader::bind()
 
 void Shader::unbind()
 {
-	gl.ActiveTexture(GL_TEXTURE0);
+	TEX::setActiveUnit(0);
 	glState.program.set(0);
 }
 
@@ -214,19 +214,88 @@ void Shader::initFromFile(const char *_vertFile, const char *_fragFile,
 	     _vertFile, _fragFile, programName);
 }
 
+bool Shader::uniformChanged(GLint location, const GLfloat *values, size_t count)
+{
+	/* Uniforms optimized out by the GLSL compiler */
+	if (location == -1)
+		return false;
+
+	CachedUniform *entry = 0;
+
+	/* Programs only have a handful of uniforms,
+	 * a linear search is plenty fast here */
+	for (size_t i = 0; i < uniformCache.size(); ++i)
+		if (uniformCache[i].location == location)
+		{
+			entry = &uniformCache[i];
+			break;
+		}
+
+	if (!entry)
+	{
+		uniformCache.push_back(CachedUniform());
+		entry = &uniformCache.back();
+		entry->location = location;
+		entry->count = 0;
+	}
+	else if (entry->count == count &&
+	         memcmp(entry->value, values, count * sizeof(GLfloat)) == 0)
+	{
+		++glState.stats.uniformSkips;
+		return false;
+	}
+
+	memcpy(entry->value, values, count * sizeof(GLfloat));
+	entry->count = count;
+
+	++glState.stats.uniformUploads;
+	return true;
+}
+
+void Shader::setFloatUniform(GLint location, float value)
+{
+	if (uniformChanged(location, &value, 1))
+		gl.Uniform1f(location, value);
+}
+
+void Shader::setVec2Uniform(GLint location, float x, float y)
+{
+	const GLfloat values[] = { x, y };
+
+	if (uniformChanged(location, values, 2))
+		gl.Uniform2f(location, x, y);
+}
+
 void Shader::setVec4Uniform(GLint location, const Vec4 &vec)
 {
-	gl.Uniform4f(location, vec.x, vec.y, vec.z, vec.w);
+	const GLfloat values[] = { vec.x, vec.y, vec.z, vec.w };
+
+	if (uniformChanged(location, values, 4))
+		gl.Uniform4f(location, vec.x, vec.y, vec.z, vec.w);
 }
 
-void Shader::setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture)
+void Shader::setMat4Uniform(GLint location, const float value[16])
 {
-	GLenum texUnit = GL_TEXTURE0 + unitIndex;
+	if (uniformChanged(location, value, 16))
+		gl.UniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+void Shader::setIntUniform(GLint location, int value)
+{
+	/* Only used for sampler units, which are
+	 * represented exactly as floats */
+	const GLfloat cached = value;
 
-	gl.ActiveTexture(texUnit);
-	gl.BindTexture(GL_TEXTURE_2D, texture.gl);
-	gl.Uniform1i(location, unitIndex);
-	gl.ActiveTexture(GL_TEXTURE0);
+	if (uniformChanged(location, &cached, 1))
+		gl.Uniform1i(location, value);
+}
+
+void Shader::setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture)
+{
+	TEX::setActiveUnit(unitIndex);
+	TEX::bind(texture);
+	setIntUniform(location, unitIndex);
+	TEX::setActiveUnit(0);
 }
 
 void ShaderBase::GLProjMat::apply(const Vec2i &value)
@@ -263,12 +332,12 @@ void ShaderBase::applyViewportProj()
 
 void ShaderBase::setTexSize(const Vec2i &value)
 {
-	gl.Uniform2f(u_texSizeInv, 1.f / value.x, 1.f / value.y);
+	setVec2Uniform(u_texSizeInv, 1.f / value.x, 1.f / value.y);
 }
 
 void ShaderBase::setTranslation(const Vec2i &value)
 {
-	gl.Uniform2f(u_translation, value.x, value.y);
+	setVec2Uniform(u_translation, value.x, value.y);
 }
 
 
@@ -298,7 +367,7 @@ SimpleShader::SimpleShader()
 
 void SimpleShader::setTexOffsetX(int value)
 {
-	gl.Uniform1f(u_texOffsetX, value);
+	setFloatUniform(u_texOffsetX, value);
 }
 
 
@@ -329,7 +398,7 @@ SimpleSpriteShader::SimpleSpriteShader()
 
 void SimpleSpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 
@@ -345,12 +414,12 @@ AlphaSpriteShader::AlphaSpriteShader()
 
 void AlphaSpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 void AlphaSpriteShader::setAlpha(float value)
 {
-	gl.Uniform1f(u_alpha, value);
+	setFloatUniform(u_alpha, value);
 }
 
 
@@ -384,12 +453,12 @@ void TransShader::setTransMap(TEX::ID tex)
 
 void TransShader::setProg(float value)
 {
-	gl.Uniform1f(u_prog, value);
+	setFloatUniform(u_prog, value);
 }
 
 void TransShader::setVague(float value)
 {
-	gl.Uniform1f(u_vague, value);
+	setFloatUniform(u_vague, value);
 }
 
 
@@ -416,7 +485,7 @@ void SimpleTransShader::setFrozenScene(TEX::ID tex)
 
 void SimpleTransShader::setProg(float value)
 {
-	gl.Uniform1f(u_prog, value);
+	setFloatUniform(u_prog, value);
 }
 
 
@@ -436,7 +505,7 @@ SpriteShader::SpriteShader()
 
 void SpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 void SpriteShader::setTone(const Vec4 &tone)
@@ -451,17 +520,17 @@ void SpriteShader::setColor(const Vec4 &color)
 
 void SpriteShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	setFloatUniform(u_opacity, value);
 }
 
 void SpriteShader::setBushDepth(float value)
 {
-	gl.Uniform1f(u_bushDepth, value);
+	setFloatUniform(u_bushDepth, value);
 }
 
 void SpriteShader::setBushOpacity(float value)
 {
-	gl.Uniform1f(u_bushOpacity, value);
+	setFloatUniform(u_bushOpacity, value);
 }
 
 
@@ -494,7 +563,7 @@ void PlaneShader::setFlash(const Vec4 &flash)
 
 void PlaneShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	setFloatUniform(u_opacity, value);
 }
 
 
@@ -509,7 +578,7 @@ GrayShader::GrayShader()
 
 void GrayShader::setGray(float value)
 {
-	gl.Uniform1f(u_gray, value);
+	setFloatUniform(u_gray, value);
 }
 
 
@@ -524,7 +593,7 @@ TilemapShader::TilemapShader()
 
 void TilemapShader::setAniIndex(int value)
 {
-	gl.Uniform1f(u_aniIndex, value);
+	setFloatUniform(u_aniIndex, value);
 }
 
 
@@ -540,7 +609,7 @@ FlashMapShader::FlashMapShader()
 
 void FlashMapShader::setAlpha(float value)
 {
-	gl.Uniform1f(u_alpha, value);
+	setFloatUniform(u_alpha, value);
 }
 
 
@@ -556,7 +625,7 @@ HueShader::HueShader()
 
 void HueShader::setHueAdjust(float value)
 {
-	gl.Uniform1f(u_hueAdjust, value);
+	setFloatUniform(u_hueAdjust, value);
 }
 
 void HueShader::setInputTexture(TEX::ID tex)
@@ -576,7 +645,7 @@ SimpleMatrixShader::SimpleMatrixShader()
 
 void SimpleMatrixShader::setMatrix(const float value[16])
 {
-	gl.UniformMatrix4fv(u_matrix, 1, GL_FALSE, value);
+	setMat4Uniform(u_matrix, value);
 }
 
 
@@ -606,7 +675,7 @@ TilemapVXShader::TilemapVXShader()
 
 void TilemapVXShader::setAniOffset(const Vec2 &value)
 {
-	gl.Uniform2f(u_aniOffset, value.x, value.y);
+	setVec2Uniform(u_aniOffset, value.x, value.y);
 }
 
 
@@ -624,7 +693,7 @@ BltShader::BltShader()
 
 void BltShader::setSource()
 {
-	gl.Uniform1i(u_source, 0);
+	setIntUniform(u_source, 0);
 }
 
 void BltShader::setDestination(const TEX::ID value)
@@ -634,10 +703,10 @@ void BltShader::setDestination(const TEX::ID value)
 
 void BltShader::setSubRect(const FloatRect &value)
 {
-	gl.Uniform4f(u_subRect, value.x, value.y, value.w, value.h);
+	setVec4Uniform(u_subRect, Vec4(value.x, value.y, value.w, value.h));
 }
 
 void BltShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	setFloatUniform(u_opacity, value);
 }
@@ -26,6 +26,8 @@
 #include "gl-util.h"
 #include "glstate.h"
 
+#include <vector>
+
 class Shader
 {
 public:
@@ -50,11 +52,32 @@ protected:
 	void initFromFile(const char *vertFile, const char *fragFile,
 	                  const char *programName);
 
-	static void setVec4Uniform(GLint location, const Vec4 &vec);
-	static void setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture);
+	/* All uniform setters go through the upload cache below,
+	 * and skip the GL call if the value is unchanged since
+	 * the last upload to this program */
+	void setFloatUniform(GLint location, float value);
+	void setVec2Uniform(GLint location, float x, float y);
+	void setVec4Uniform(GLint location, const Vec4 &vec);
+	void setMat4Uniform(GLint location, const float value[16]);
+	void setIntUniform(GLint location, int value);
+	void setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture);
 
 	GLuint vertShader, fragShader;
 	GLuint program;
+
+private:
+	struct CachedUniform
+	{
+		GLint location;
+		size_t count;
+		GLfloat value[16];
+	};
+
+	/* Returns true if 'values' differ from the last values
+	 * uploaded to 'location' (and caches them in that case) */
+	bool uniformChanged(GLint location, const GLfloat *values, size_t count);
+
+	std::vector<CachedUniform> uniformCache;
 };
 
 class ShaderBase : public Shader
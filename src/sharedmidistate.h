@@ -25,8 +25,14 @@
 #include "config.h"
 #include "debugwriter.h"
 #include "fluid-fun.h"
+#include "midicache.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_timer.h>
 
 #include <assert.h>
+#include <string.h>
 #include <vector>
 #include <string>
 
@@ -46,47 +52,109 @@ struct SharedMidiState
 	const std::string &soundFont;
 	fluid_settings_t *flSettings;
 
+	/* Loaded once by the first synth, which owns it, and then
+	 * shared with all others. Null if loading failed */
+	fluid_sfont_t *sfont;
+
+	/* Synths are also allocated by the cache's render thread */
+	SDL_mutex *synthMut;
+
+	/* The initial synths are created (and the soundfont loaded)
+	 * on a background thread; allocations wait for it to finish */
+	SDL_cond *warmCond;
+	SDL_Thread *warmThread;
+	bool warming;
+
+	/* Print warm-up time and the stats below */
+	const bool printStats;
+
+	struct
+	{
+		uint32_t allocs;
+		uint32_t created;
+		uint32_t waited;
+		uint64_t totalMicros;
+		uint64_t maxMicros;
+	} stats;
+
+	std::string cacheDir;
+	MidiCache *cache;
+
 	SharedMidiState(const Config &conf)
 	    : inited(false),
-	      soundFont(conf.midi.soundFont)
-	{}
+	      soundFont(conf.midi.soundFont),
+	      sfont(0),
+	      synthMut(SDL_CreateMutex()),
+	      warmCond(SDL_CreateCond()),
+	      warmThread(0),
+	      warming(false),
+	      printStats(conf.printCacheStats),
+	      cache(0)
+	{
+		memset(&stats, 0, sizeof(stats));
+	}
 
 	~SharedMidiState()
 	{
+		if (warmThread)
+			SDL_WaitThread(warmThread, 0);
+
+		/* Stops the render thread, which might hold a synth */
+		delete cache;
+
+		SDL_DestroyCond(warmCond);
+		SDL_DestroyMutex(synthMut);
+
 		/* We might have initialized, but if the consecutive libfluidsynth
 		 * load failed, no resources will have been allocated */
 		if (!inited || !HAVE_FLUID)
 			return;
 
+		if (printStats && stats.allocs > 0)
+			Debug() << "MIDI synths:" << stats.allocs << "allocations,"
+			        << stats.created << "created on demand,"
+			        << stats.waited << "waited for warm-up,"
+			        << "avg" << stats.totalMicros / stats.allocs << "us,"
+			        << "max" << stats.maxMicros << "us";
+
 		fluid.delete_settings(flSettings);
 
-		for (size_t i = 0; i < synths.size(); ++i)
+		/* Synths delete the soundfonts they hold, so the shared
+		 * one is taken away from all but its owner, which goes last */
+		for (size_t i = synths.size(); i-- > 0;)
 		{
 			assert(!synths[i].inUse);
+
+			if (sfont && i > 0)
+				fluid.synth_remove_sfont(synths[i].synth, sfont);
+
 			fluid.delete_synth(synths[i].synth);
 		}
 	}
 
+	/* Streams may also be opened on a background
+	 * thread (AudioStream::queue()) */
 	void initIfNeeded(const Config &conf)
 	{
-		if (inited)
-			return;
+		SDL_LockMutex(synthMut);
 
-		inited = true;
-
-		initFluidFunctions();
+		if (!inited)
+			init(conf);
 
-		if (!HAVE_FLUID)
-			return;
+		SDL_UnlockMutex(synthMut);
+	}
 
-		flSettings = fluid.new_settings();
-		fluid.settings_setnum(flSettings, "synth.gain", 1.0);
-		fluid.settings_setnum(flSettings, "synth.sample-rate", SYNTH_SAMPLERATE);
-		fluid.settings_setstr(flSettings, "synth.chorus.active", conf.midi.chorus ? "yes" : "no");
-		fluid.settings_setstr(flSettings, "synth.reverb.active", conf.midi.reverb ? "yes" : "no");
+	/* Renderings are stored in 'dir'; takes effect on initialization */
+	void initRenderCache(const char *dir)
+	{
+		if (dir)
+			cacheDir = dir;
+	}
 
-		for (size_t i = 0; i < SYNTH_INIT_COUNT; ++i)
-			addSynth(false);
+	/* Null unless the render cache is enabled */
+	MidiCache *renderCache()
+	{
+		return cache;
 	}
 
 	fluid_synth_t *allocateSynth()
@@ -94,7 +162,18 @@ struct SharedMidiState
 		assert(HAVE_FLUID);
 		assert(inited);
 
+		uint64_t start = SDL_GetPerformanceCounter();
+
+		SDL_LockMutex(synthMut);
+
+		if (warming)
+			++stats.waited;
+
+		while (warming)
+			SDL_CondWait(warmCond, synthMut);
+
 		size_t i;
+		fluid_synth_t *syn;
 
 		for (i = 0; i < synths.size(); ++i)
 			if (!synths[i].inUse)
@@ -102,20 +181,34 @@ struct SharedMidiState
 
 		if (i < synths.size())
 		{
-			fluid_synth_t *syn = synths[i].synth;
+			syn = synths[i].synth;
 			fluid.synth_system_reset(syn);
 			synths[i].inUse = true;
-
-			return syn;
 		}
 		else
 		{
-			return addSynth(true);
+			syn = addSynth(true);
+			++stats.created;
 		}
+
+		uint64_t micros = (SDL_GetPerformanceCounter() - start) * 1000000
+		                / SDL_GetPerformanceFrequency();
+
+		++stats.allocs;
+		stats.totalMicros += micros;
+
+		if (micros > stats.maxMicros)
+			stats.maxMicros = micros;
+
+		SDL_UnlockMutex(synthMut);
+
+		return syn;
 	}
 
 	void releaseSynth(fluid_synth_t *synth)
 	{
+		SDL_LockMutex(synthMut);
+
 		size_t i;
 
 		for (i = 0; i < synths.size(); ++i)
@@ -125,17 +218,70 @@ struct SharedMidiState
 		assert(i < synths.size());
 
 		synths[i].inUse = false;
+
+		SDL_UnlockMutex(synthMut);
 	}
 
 private:
+	void init(const Config &conf)
+	{
+		inited = true;
+
+		initFluidFunctions();
+
+		if (!HAVE_FLUID)
+			return;
+
+		flSettings = fluid.new_settings();
+		fluid.settings_setnum(flSettings, "synth.gain", 1.0);
+		fluid.settings_setnum(flSettings, "synth.sample-rate", SYNTH_SAMPLERATE);
+		fluid.settings_setstr(flSettings, "synth.chorus.active", conf.midi.chorus ? "yes" : "no");
+		fluid.settings_setstr(flSettings, "synth.reverb.active", conf.midi.reverb ? "yes" : "no");
+
+		warming = true;
+		warmThread = createSDLThread
+			<SharedMidiState, &SharedMidiState::warmUp>(this, "midiwarmup");
+
+		/* Without a soundfont, there's nothing worth keeping */
+		if (!cacheDir.empty() && !soundFont.empty())
+			cache = new MidiCache(conf, cacheDir.c_str());
+	}
+
+	void warmUp()
+	{
+		uint32_t start = SDL_GetTicks();
+
+		/* Nobody else touches the pool until warming is cleared */
+		for (size_t i = 0; i < SYNTH_INIT_COUNT; ++i)
+			addSynth(false);
+
+		if (printStats)
+			Debug() << "MIDI:" << SYNTH_INIT_COUNT << "synths ready in"
+			        << SDL_GetTicks() - start << "ms";
+
+		SDL_LockMutex(synthMut);
+		warming = false;
+		SDL_CondBroadcast(warmCond);
+		SDL_UnlockMutex(synthMut);
+	}
+
 	fluid_synth_t *addSynth(bool usedNow)
 	{
 		fluid_synth_t *syn = fluid.new_synth(flSettings);
 
-		if (!soundFont.empty())
-			fluid.synth_sfload(syn, soundFont.c_str(), 1);
-		else
+		if (sfont)
+		{
+			fluid.synth_add_sfont(syn, sfont);
+		}
+		else if (synths.empty() && !soundFont.empty())
+		{
+			if (fluid.synth_sfload(syn, soundFont.c_str(), 1) != -1)
+				sfont = fluid.synth_get_sfont(syn, 0);
+		}
+		else if (synths.empty())
+		{
 			Debug() << "Warning: No soundfont specified, sound might be mute";
+		}
 
 		Synth synth;
 		synth.inUse = usedNow;
@@ -59,6 +59,18 @@ static const char *gameArchExt()
 	return 0;
 }
 
+static const char *dataDir(const Config &conf)
+{
+	/* Same preference as for the stored key bindings */
+	if (!conf.customDataPath.empty())
+		return conf.customDataPath.c_str();
+
+	if (!conf.commonDataPath.empty())
+		return conf.commonDataPath.c_str();
+
+	return 0;
+}
+
 struct SharedStatePrivate
 {
 	void *bindingData;
@@ -101,7 +113,10 @@ struct SharedStatePrivate
 	SharedStatePrivate(RGSSThreadData *threadData)
 	    : bindingData(0),
 	      sdlWindow(threadData->window),
-	      fileSystem(threadData->argv0, threadData->config.allowSymlinks),
+	      fileSystem(threadData->argv0, threadData->config.allowSymlinks,
+	                 threadData->config.mmapArchives,
+	                 threadData->config.archiveIndexCache
+	                     ? dataDir(threadData->config) : 0),
 	      eThread(*threadData->ethread),
 	      rtData(*threadData),
 	      config(threadData->config),
@@ -116,6 +131,9 @@ struct SharedStatePrivate
 		if (gl.ReleaseShaderCompiler)
 			gl.ReleaseShaderCompiler();
 
+		if (config.assetTrace)
+			fileSystem.initAccessTrace(dataDir(config));
+
 		std::string archPath = config.execName + gameArchExt();
 
 		/* Check if a game archive exists */
@@ -132,9 +150,14 @@ struct SharedStatePrivate
 			fileSystem.addPath(config.rtps[i].c_str());
 
 		if (config.pathCache)
-			fileSystem.createPathCache();
+			fileSystem.createPathCache(config.persistPathCache
+			                           ? dataDir(config) : 0);
 
-		fileSystem.initFontSets(fontState);
+		fileSystem.initFontSets(fontState, config.fontIndexCache
+		                                   ? dataDir(config) : 0);
+
+		fileSystem.initPrefetch(config.prefetchCacheSize * 1024 * 1024,
+		                        dataDir(config), config.printCacheStats);
 
 		globalTexW = 128;
 		globalTexH = 64;
@@ -151,9 +174,13 @@ struct SharedStatePrivate
 		TEXFBO::allocEmpty(gpTexFBO, globalTexW, globalTexH);
 		TEXFBO::linkFBO(gpTexFBO);
 
-		/* RGSS3 games will call setup_midi, so there's
-		 * no need to do it on startup */
-		if (rgssVer <= 2)
+		if (config.midi.renderCache)
+			midiState.initRenderCache(dataDir(config));
+
+		/* RGSS3 games will call setup_midi, so there's no need to do
+		 * it on startup, unless we can load the soundfont ahead of time
+		 * (this happens in the background) */
+		if (rgssVer <= 2 || !config.midi.soundFont.empty())
 			midiState.initIfNeeded(threadData->config);
 	}
 
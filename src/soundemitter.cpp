@@ -27,10 +27,13 @@
 #include "config.h"
 #include "util.h"
 #include "debugwriter.h"
+#include "alstream.h"
+#include "sdl-util.h"
 
 #include <SDL_sound.h>
 
-#define SE_CACHE_MEM (10*1024*1024) // 10 MB
+/* Sources for sounds played before they're decoded */
+#define SE_STREAM_COUNT 2
 
 struct SoundBuffer
 {
@@ -88,12 +91,19 @@ arrayPushBack(std::vector<size_t> &array, size_t size, size_t index)
 	array[size-1] = v;
 }
 
-SoundEmitter::SoundEmitter(const Config &conf)
+SoundEmitter::SoundEmitter(const Config &conf,
+                           AudioScheduler &scheduler)
     : bufferBytes(0),
+      cacheSize(conf.SE.cacheSize * 1024 * 1024),
+      reducedPrecision(conf.SE.reducedPrecision),
+      printStats(conf.printCacheStats),
       srcCount(conf.SE.sourceCount),
       alSrcs(srcCount),
       atchBufs(srcCount),
-      srcPrio(srcCount)
+      srcPrio(srcCount),
+      decodeTermReq(false),
+      streams(SE_STREAM_COUNT),
+      nextStream(0)
 {
 	for (size_t i = 0; i < srcCount; ++i)
 	{
@@ -101,10 +111,46 @@ SoundEmitter::SoundEmitter(const Config &conf)
 		atchBufs[i] = 0;
 		srcPrio[i] = i;
 	}
+
+	stats.hits = stats.misses = stats.evictions = 0;
+	stats.decodedBytes = 0;
+
+	for (size_t i = 0; i < streams.size(); ++i)
+	{
+		char id[16];
+		snprintf(id, sizeof(id), "se %d", (int) i);
+
+		streams[i] = new ALStream(ALStream::NotLooped, id, scheduler);
+	}
+
+	decodeMut = SDL_CreateMutex();
+	decodeCond = SDL_CreateCond();
+	decodeThread = createSDLThread
+		<SoundEmitter, &SoundEmitter::decodeSounds>(this, "se_decode");
 }
 
 SoundEmitter::~SoundEmitter()
 {
+	if (printStats && (stats.hits > 0 || stats.misses > 0))
+		Debug() << "SE cache:" << stats.hits << "hits," << stats.misses << "misses,"
+		        << stats.evictions << "evictions," << stats.decodedBytes / 1024
+		        << "KiB decoded";
+
+	SDL_LockMutex(decodeMut);
+	decodeTermReq = true;
+	SDL_CondSignal(decodeCond);
+	SDL_UnlockMutex(decodeMut);
+
+	SDL_WaitThread(decodeThread, 0);
+	SDL_DestroyCond(decodeCond);
+	SDL_DestroyMutex(decodeMut);
+
+	for (size_t i = 0; i < decoded.size(); ++i)
+		SoundBuffer::deref(decoded[i]);
+
+	for (size_t i = 0; i < streams.size(); ++i)
+		delete streams[i];
+
 	for (size_t i = 0; i < srcCount; ++i)
 	{
 		AL::Source::stop(alSrcs[i]);
@@ -126,10 +172,22 @@ void SoundEmitter::play(const std::string &filename,
 	float _volume = clamp<int>(volume, 0, 100) / 100.f;
 	float _pitch  = clamp<int>(pitch, 50, 150) / 100.f;
 
-	SoundBuffer *buffer = allocateBuffer(filename);
+	collectDecoded();
+
+	SoundBuffer *buffer = findBuffer(filename);
 
 	if (!buffer)
+	{
+		/* Don't hold up the frame decoding the whole sound,
+		 * stream it this time and have it ready for the next */
+		playStreamed(filename, _volume, _pitch);
+		queueDecode(filename);
+		++stats.misses;
+
 		return;
+	}
+
+	++stats.hits;
 
 	/* Try to find first free source */
 	size_t i;
@@ -178,13 +236,24 @@ void SoundEmitter::play(const std::string &filename,
 	AL::Source::play(src);
 }
 
+void SoundEmitter::preload(const std::string &filename)
+{
+	collectDecoded();
+
+	if (!bufferHash.contains(filename))
+		queueDecode(filename);
+}
+
 void SoundEmitter::stop()
 {
 	for (size_t i = 0; i < srcCount; i++)
 		AL::Source::stop(alSrcs[i]);
+
+	for (size_t i = 0; i < streams.size(); ++i)
+		streams[i]->stop();
 }
 
-SoundBuffer *SoundEmitter::allocateBuffer(const std::string &filename)
+SoundBuffer *SoundEmitter::findBuffer(const std::string &filename)
 {
 	SoundBuffer *buffer = bufferHash.value(filename, 0);
 
@@ -193,66 +262,208 @@ SoundBuffer *SoundEmitter::allocateBuffer(const std::string &filename)
 		/* Buffer still in cashe.
 		 * Move to front of priority list */
 		buffers.remove(buffer->link);
-		buffers.append(buffer->link);
+		buffers.prepend(buffer->link);
+	}
 
-		return buffer;
+	return buffer;
+}
+
+/* Converts 16 bit samples to unsigned 8 bit ones in place,
+ * returns the new byte count */
+static uint32_t reduceSamples(uint8_t *data, uint32_t bytes, int format)
+{
+	const bool isSigned = SDL_AUDIO_ISSIGNED(format);
+	const bool bigEndian = SDL_AUDIO_ISBIGENDIAN(format);
+
+	uint32_t count = bytes / 2;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint8_t hi = data[i*2 + (bigEndian ? 0 : 1)];
+
+		/* The high byte alone is the 8 bit sample,
+		 * with the sign bit flipped if it is signed */
+		data[i] = isSigned ? hi ^ 0x80 : hi;
 	}
-	else
+
+	return count;
+}
+
+/* Loads and fully decodes 'filename', for any thread */
+static SoundBuffer *decodeBuffer(const std::string &filename,
+                                 bool reducedPrecision)
+{
+	SDL_RWops dataSource;
+	char ext[8];
+
+	shState->fileSystem().openReadMapped(dataSource, filename.c_str(),
+	                                     false, ext, sizeof(ext),
+	                                     FileSystem::ReqAudio);
+
+	Sound_Sample *sampleHandle = Sound_NewSample(&dataSource, ext, 0, STREAM_BUF_SIZE);
+
+	if (!sampleHandle)
 	{
-		/* Buffer not in cashe, needs to be loaded */
-		SDL_RWops dataSource;
-		char ext[8];
+		char buf[512];
+		snprintf(buf, sizeof(buf), "Unable to decode sound: %s.%s: %s",
+		         filename.c_str(), ext, Sound_GetError());
+		Debug() << buf;
 
-		shState->fileSystem().openRead(dataSource, filename.c_str(),
-		                               false, ext, sizeof(ext));
+		return 0;
+	}
 
-		Sound_Sample *sampleHandle = Sound_NewSample(&dataSource, ext, 0, STREAM_BUF_SIZE);
+	uint32_t decBytes = Sound_DecodeAll(sampleHandle);
+	uint8_t sampleSize = formatSampleSize(sampleHandle->actual.format);
+	uint32_t sampleCount = decBytes / sampleSize;
 
-		if (!sampleHandle)
-		{
-			char buf[512];
-			snprintf(buf, sizeof(buf), "Unable to decode sound: %s.%s: %s",
-			         filename.c_str(), ext, Sound_GetError());
-			Debug() << buf;
+	if (reducedPrecision && sampleSize == 2)
+	{
+		reduceSamples(static_cast<uint8_t*>(sampleHandle->buffer),
+		              sampleCount * sampleSize, sampleHandle->actual.format);
+		sampleSize = 1;
+	}
 
-			return 0;
-		}
+	SoundBuffer *buffer = new SoundBuffer;
+	buffer->key = filename;
+	buffer->bytes = sampleSize * sampleCount;
+
+	ALenum alFormat = chooseALFormat(sampleSize, sampleHandle->actual.channels);
+
+	AL::Buffer::uploadData(buffer->alBuffer, alFormat, sampleHandle->buffer,
+						   buffer->bytes, sampleHandle->actual.rate);
+
+	Sound_FreeSample(sampleHandle);
 
-		uint32_t decBytes = Sound_DecodeAll(sampleHandle);
-		uint8_t sampleSize = formatSampleSize(sampleHandle->actual.format);
-		uint32_t sampleCount = decBytes / sampleSize;
+	return buffer;
+}
+
+void SoundEmitter::cacheBuffer(SoundBuffer *buffer)
+{
+	uint32_t wouldBeBytes = bufferBytes + buffer->bytes;
+
+	/* If memory limit is reached, delete lowest priority buffer
+	 * until there is room or no buffers left */
+	while (wouldBeBytes > cacheSize && !buffers.isEmpty())
+	{
+		SoundBuffer *last = buffers.tail();
+		bufferHash.remove(last->key);
+		buffers.remove(last->link);
+
+		wouldBeBytes -= last->bytes;
 
-		buffer = new SoundBuffer;
-		buffer->key = filename;
-		buffer->bytes = sampleSize * sampleCount;
+		SoundBuffer::deref(last);
+		++stats.evictions;
+	}
+
+	bufferHash.insert(buffer->key, buffer);
+	buffers.prepend(buffer->link);
+
+	bufferBytes = wouldBeBytes;
+}
 
-		ALenum alFormat = chooseALFormat(sampleSize, sampleHandle->actual.channels);
+void SoundEmitter::queueDecode(const std::string &filename)
+{
+	SDL_LockMutex(decodeMut);
 
-		AL::Buffer::uploadData(buffer->alBuffer, alFormat, sampleHandle->buffer,
-							   buffer->bytes, sampleHandle->actual.rate);
+	if (!decodePending.contains(filename) && !decodeFailed.contains(filename))
+	{
+		decodePending.insert(filename);
+		decodeQueue.push_back(filename);
+		SDL_CondSignal(decodeCond);
+	}
+
+	SDL_UnlockMutex(decodeMut);
+}
+
+void SoundEmitter::collectDecoded()
+{
+	std::vector<SoundBuffer*> ready;
+
+	SDL_LockMutex(decodeMut);
+	ready.swap(decoded);
+	SDL_UnlockMutex(decodeMut);
+
+	for (size_t i = 0; i < ready.size(); ++i)
+	{
+		stats.decodedBytes += ready[i]->bytes;
+
+		if (bufferHash.contains(ready[i]->key))
+			SoundBuffer::deref(ready[i]);
+		else
+			cacheBuffer(ready[i]);
+	}
+}
 
-		Sound_FreeSample(sampleHandle);
+void SoundEmitter::playStreamed(const std::string &filename,
+                                float volume,
+                                float pitch)
+{
+	/* Take a stopped stream if there is one,
+	 * otherwise cut off the one started longest ago */
+	size_t pick = nextStream;
 
-		uint32_t wouldBeBytes = bufferBytes + buffer->bytes;
+	for (size_t i = 0; i < streams.size(); ++i)
+	{
+		size_t j = (nextStream + i) % streams.size();
 
-		/* If memory limit is reached, delete lowest priority buffer
-		 * until there is room or no buffers left */
-		while (wouldBeBytes > SE_CACHE_MEM && !buffers.isEmpty())
+		if (streams[j]->queryState() != ALStream::Playing)
 		{
-			SoundBuffer *last = buffers.tail();
-			bufferHash.remove(last->key);
-			buffers.remove(last->link);
+			pick = j;
+			break;
+		}
+	}
+
+	nextStream = (pick + 1) % streams.size();
+	ALStream *stream = streams[pick];
 
-			wouldBeBytes -= last->bytes;
+	/* This will throw on errors while
+	 * opening the data source */
+	stream->open(filename);
+
+	stream->setVolume(volume * GLOBAL_VOLUME);
+	stream->setPitch(pitch);
+	stream->play();
+}
+
+/* thread func */
+void SoundEmitter::decodeSounds()
+{
+	SDL_LockMutex(decodeMut);
+
+	while (true)
+	{
+		while (decodeQueue.empty() && !decodeTermReq)
+			SDL_CondWait(decodeCond, decodeMut);
 
-			SoundBuffer::deref(last);
+		if (decodeTermReq)
+			break;
+
+		std::string filename = decodeQueue.front();
+		decodeQueue.pop_front();
+
+		SDL_UnlockMutex(decodeMut);
+
+		SoundBuffer *buffer = 0;
+
+		try
+		{
+			buffer = decodeBuffer(filename, reducedPrecision);
+		}
+		catch (const Exception &e)
+		{
+			/* Playing it will report the error to the script */
+			Debug() << "Unable to preload sound:" << e.msg;
 		}
 
-		bufferHash.insert(filename, buffer);
-		buffers.prepend(buffer->link);
+		SDL_LockMutex(decodeMut);
 
-		bufferBytes = wouldBeBytes;
+		decodePending.remove(filename);
 
-		return buffer;
+		if (buffer)
+			decoded.push_back(buffer);
+		else
+			decodeFailed.insert(filename);
 	}
+
+	SDL_UnlockMutex(decodeMut);
 }
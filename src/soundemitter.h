@@ -26,10 +26,16 @@
 #include "al-util.h"
 #include "boost-hash.h"
 
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
 #include <string>
 #include <vector>
+#include <deque>
 
 struct SoundBuffer;
+struct ALStream;
+struct AudioScheduler;
 struct Config;
 
 struct SoundEmitter
@@ -42,6 +48,23 @@ struct SoundEmitter
 	/* Byte count sum of all cached / playing buffers */
 	uint32_t bufferBytes;
 
+	const uint32_t cacheSize;
+	const bool reducedPrecision;
+
+	/* Print the stats below on exit */
+	const bool printStats;
+
+	struct Stats
+	{
+		/* Plays served from the cache / streamed */
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int evictions;
+
+		/* Total size of all buffers decoded */
+		uint64_t decodedBytes;
+	} stats;
+
 	const size_t srcCount;
 	std::vector<AL::Source::ID> alSrcs;
 	std::vector<SoundBuffer*> atchBufs;
@@ -49,17 +72,52 @@ struct SoundEmitter
 	/* Indices of sources, sorted by priority (lowest first) */
 	std::vector<size_t> srcPrio;
 
-	SoundEmitter(const Config &conf);
+	/* Sounds not in the cache are decoded on a background
+	 * thread, and streamed in the meantime when played */
+	std::deque<std::string> decodeQueue;
+	/* Queued or being decoded */
+	BoostSet<std::string> decodePending;
+	/* Failed to decode this session, so they're
+	 * always streamed instead of decoded over and over */
+	BoostSet<std::string> decodeFailed;
+	/* Decoded, waiting to be put into the cache */
+	std::vector<SoundBuffer*> decoded;
+
+	SDL_mutex *decodeMut;
+	SDL_cond *decodeCond;
+	SDL_Thread *decodeThread;
+	bool decodeTermReq;
+
+	std::vector<ALStream*> streams;
+	size_t nextStream;
+
+	SoundEmitter(const Config &conf,
+	             AudioScheduler &scheduler);
 	~SoundEmitter();
 
 	void play(const std::string &filename,
 	          int volume,
 	          int pitch);
 
+	/* Decodes 'filename' in the background
+	 * so it plays from memory right away */
+	void preload(const std::string &filename);
+
 	void stop();
 
 private:
-	SoundBuffer *allocateBuffer(const std::string &filename);
+	SoundBuffer *findBuffer(const std::string &filename);
+	void cacheBuffer(SoundBuffer *buffer);
+
+	void queueDecode(const std::string &filename);
+	void collectDecoded();
+
+	void playStreamed(const std::string &filename,
+	                  float volume,
+	                  float pitch);
+
+	/* thread func */
+	void decodeSounds();
 };
 
 #endif // SOUNDEMITTER_H
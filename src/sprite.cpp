@@ -42,7 +42,11 @@
 
 struct SpritePrivate
 {
+	Sprite *self;
+
 	Bitmap *bitmap;
+	sigc::connection bitmapCon;
+	sigc::connection bitmapDispCon;
 
 	Quad quad;
 	Transform trans;
@@ -66,6 +70,8 @@ struct SpritePrivate
 
 	Color *color;
 	Tone *tone;
+	sigc::connection colorCon;
+	sigc::connection toneCon;
 
 	struct
 	{
@@ -85,8 +91,9 @@ struct SpritePrivate
 
 	sigc::connection prepareCon;
 
-	SpritePrivate()
-	    : bitmap(0),
+	SpritePrivate(Sprite *self)
+	    : self(self),
+	      bitmap(0),
 	      srcRect(&tmp.rect),
 	      mirrored(false),
 	      bushDepth(0),
@@ -102,6 +109,7 @@ struct SpritePrivate
 		sceneRect.x = sceneRect.y = 0;
 
 		updateSrcRectCon();
+		updateEffectCons();
 
 		prepareCon = shState->prepareDraw.connect
 		        (sigc::mem_fun(this, &SpritePrivate::prepare));
@@ -116,9 +124,18 @@ struct SpritePrivate
 	~SpritePrivate()
 	{
 		srcRectCon.disconnect();
+		bitmapCon.disconnect();
+		bitmapDispCon.disconnect();
+		colorCon.disconnect();
+		toneCon.disconnect();
 		prepareCon.disconnect();
 	}
 
+	void markDirty()
+	{
+		self->markSceneDirty();
+	}
+
 	void recomputeBushDepth()
 	{
 		if (!bitmap)
@@ -143,6 +160,7 @@ struct SpritePrivate
 		recomputeBushDepth();
 
 		wave.dirty = true;
+		markDirty();
 	}
 
 	void updateSrcRectCon()
@@ -154,6 +172,31 @@ struct SpritePrivate
 				(sigc::mem_fun(this, &SpritePrivate::onSrcRectChange));
 	}
 
+	void updateEffectCons()
+	{
+		colorCon.disconnect();
+		colorCon = color->valueChanged.connect
+		        (sigc::mem_fun(this, &SpritePrivate::markDirty));
+
+		toneCon.disconnect();
+		toneCon = tone->valueChanged.connect
+		        (sigc::mem_fun(this, &SpritePrivate::markDirty));
+	}
+
+	void updateBitmapCons()
+	{
+		bitmapCon.disconnect();
+		bitmapDispCon.disconnect();
+
+		if (!bitmap)
+			return;
+
+		bitmapCon = bitmap->modified.connect
+		        (sigc::mem_fun(this, &SpritePrivate::markDirty));
+		bitmapDispCon = bitmap->wasDisposed.connect
+		        (sigc::mem_fun(this, &SpritePrivate::markDirty));
+	}
+
 	void updateVisibility()
 	{
 		isVisible = false;
@@ -290,7 +333,7 @@ struct SpritePrivate
 Sprite::Sprite(Viewport *viewport)
     : ViewportElement(viewport)
 {
-	p = new SpritePrivate;
+	p = new SpritePrivate(this);
 	onGeometryChange(scene->getGeometry());
 }
 
@@ -317,8 +360,9 @@ DEF_ATTR_RD_SIMPLE(Sprite, WaveLength, int,     p->wave.length)
 DEF_ATTR_RD_SIMPLE(Sprite, WaveSpeed,  int,     p->wave.speed)
 DEF_ATTR_RD_SIMPLE(Sprite, WavePhase,  float,   p->wave.phase)
 
-DEF_ATTR_SIMPLE(Sprite, BushOpacity, int,     p->bushOpacity)
-DEF_ATTR_SIMPLE(Sprite, Opacity,     int,     p->opacity)
+DEF_ATTR_RD_SIMPLE(Sprite, BushOpacity, int, p->bushOpacity)
+DEF_ATTR_RD_SIMPLE(Sprite, Opacity,     int, p->opacity)
+
 DEF_ATTR_SIMPLE(Sprite, SrcRect,     Rect&,  *p->srcRect)
 DEF_ATTR_SIMPLE(Sprite, Color,       Color&, *p->color)
 DEF_ATTR_SIMPLE(Sprite, Tone,        Tone&,  *p->tone)
@@ -331,6 +375,8 @@ void Sprite::setBitmap(Bitmap *bitmap)
 		return;
 
 	p->bitmap = bitmap;
+	p->updateBitmapCons();
+	markSceneDirty();
 
 	if (nullOrDisposed(bitmap))
 		return;
@@ -352,6 +398,7 @@ void Sprite::setX(int value)
 		return;
 
 	p->trans.setPosition(Vec2(value, getY()));
+	markSceneDirty();
 }
 
 void Sprite::setY(int value)
@@ -362,6 +409,7 @@ void Sprite::setY(int value)
 		return;
 
 	p->trans.setPosition(Vec2(getX(), value));
+	markSceneDirty();
 
 	if (rgssVer >= 2)
 	{
@@ -378,6 +426,7 @@ void Sprite::setOX(int value)
 		return;
 
 	p->trans.setOrigin(Vec2(value, getOY()));
+	markSceneDirty();
 }
 
 void Sprite::setOY(int value)
@@ -388,6 +437,7 @@ void Sprite::setOY(int value)
 		return;
 
 	p->trans.setOrigin(Vec2(getOX(), value));
+	markSceneDirty();
 }
 
 void Sprite::setZoomX(float value)
@@ -398,6 +448,7 @@ void Sprite::setZoomX(float value)
 		return;
 
 	p->trans.setScale(Vec2(value, getZoomY()));
+	markSceneDirty();
 }
 
 void Sprite::setZoomY(float value)
@@ -409,6 +460,7 @@ void Sprite::setZoomY(float value)
 
 	p->trans.setScale(Vec2(getZoomX(), value));
 	p->recomputeBushDepth();
+	markSceneDirty();
 
 	if (rgssVer >= 2)
 		p->wave.dirty = true;
@@ -422,6 +474,7 @@ void Sprite::setAngle(float value)
 		return;
 
 	p->trans.setRotation(value);
+	markSceneDirty();
 }
 
 void Sprite::setMirror(bool mirrored)
@@ -444,25 +497,56 @@ void Sprite::setBushDepth(int value)
 
 	p->bushDepth = value;
 	p->recomputeBushDepth();
+	markSceneDirty();
+}
+
+void Sprite::setBushOpacity(int value)
+{
+	guardDisposed();
+
+	if (p->bushOpacity == value)
+		return;
+
+	p->bushOpacity = value;
+	markSceneDirty();
+}
+
+void Sprite::setOpacity(int value)
+{
+	guardDisposed();
+
+	if (p->opacity == value)
+		return;
+
+	p->opacity = value;
+	markSceneDirty();
 }
 
 void Sprite::setBlendType(int type)
 {
 	guardDisposed();
 
+	BlendType value;
+
 	switch (type)
 	{
 	default :
 	case BlendNormal :
-		p->blendType = BlendNormal;
-		return;
+		value = BlendNormal;
+		break;
 	case BlendAddition :
-		p->blendType = BlendAddition;
-		return;
+		value = BlendAddition;
+		break;
 	case BlendSubstraction :
-		p->blendType = BlendSubstraction;
-		return;
+		value = BlendSubstraction;
+		break;
 	}
+
+	if (p->blendType == value)
+		return;
+
+	p->blendType = value;
+	markSceneDirty();
 }
 
 #define DEF_WAVE_SETTER(Name, name, type) \
@@ -473,6 +557,7 @@ void Sprite::setBlendType(int type)
 			return; \
 		p->wave.name = value; \
 		p->wave.dirty = true; \
+		markSceneDirty(); \
 	}
 
 DEF_WAVE_SETTER(Amp,    amp,    int)
@@ -489,6 +574,7 @@ void Sprite::initDynAttribs()
 	p->tone = new Tone;
 
 	p->updateSrcRectCon();
+	p->updateEffectCons();
 }
 
 /* Flashable */
@@ -500,6 +586,9 @@ void Sprite::update()
 
 	p->wave.phase += p->wave.speed / 180;
 	p->wave.dirty = true;
+
+	if (p->wave.amp != 0)
+		markSceneDirty();
 }
 
 /* SceneElement */
@@ -582,6 +671,12 @@ void Sprite::onGeometryChange(const Scene::Geometry &geo)
 	p->sceneOrig = geo.orig;
 }
 
+/* Flashable */
+void Sprite::onFlashChange()
+{
+	markSceneDirty();
+}
+
 void Sprite::releaseResources()
 {
 	unlink();
@@ -74,11 +74,14 @@ private:
 
 	void draw();
 	void onGeometryChange(const Scene::Geometry &);
+	void onFlashChange();
 
 	void releaseResources();
 	const char *klassName() const { return "sprite"; }
 
 	ABOUT_TO_ACCESS_DISP
+
+	friend struct SpritePrivate;
 };
 
 #endif // SPRITE_H
@@ -119,6 +119,12 @@ struct FlashMap
 		return data;
 	}
 
+	/* Only valid after prepare() */
+	bool isEmpty() const
+	{
+		return vertices.empty();
+	}
+
 	void setData(Table *value)
 	{
 		if (data == value)
@@ -316,8 +316,10 @@ struct TilemapPrivate
 	sigc::connection autotilesCon[autotileCount];
 	sigc::connection mapDataCon;
 	sigc::connection prioritiesCon;
+	sigc::connection flashDataCon;
 
 	/* Dispose watches */
+	sigc::connection tilesetDispCon;
 	sigc::connection autotilesDispCon[autotileCount];
 
 	/* Draw prepare call */
@@ -381,6 +383,7 @@ struct TilemapPrivate
 
 		/* Disconnect signal handlers */
 		tilesetCon.disconnect();
+		tilesetDispCon.disconnect();
 		for (int i = 0; i < autotileCount; ++i)
 		{
 			autotilesCon[i].disconnect();
@@ -388,6 +391,7 @@ struct TilemapPrivate
 		}
 		mapDataCon.disconnect();
 		prioritiesCon.disconnect();
+		flashDataCon.disconnect();
 
 		prepareCon.disconnect();
 	}
@@ -451,19 +455,30 @@ struct TilemapPrivate
 		dispPos = -(offset - viewpPos * 32) + elem.sceneOffset;
 	}
 
+	/* Our layers may be hidden while resources are missing,
+	 * so report to the viewport directly */
+	void markDirty()
+	{
+		if (elem.ground->scene)
+			elem.ground->scene->markDirty();
+	}
+
 	void invalidateAtlasSize()
 	{
 		atlasSizeDirty = true;
+		markDirty();
 	}
 
 	void invalidateAtlasContents()
 	{
 		atlasDirty = true;
+		markDirty();
 	}
 
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		markDirty();
 	}
 
 	/* Checks for the minimum amount of data needed to display */
@@ -1149,11 +1164,20 @@ void Tilemap::update()
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
 
+	if (!p->flashMap.isEmpty())
+		p->markDirty();
+
 	/* Animate autotiles */
 	if (!p->tiles.animated)
 		return;
 
-	p->tiles.frameIdx = atAnimation[p->tiles.aniIdx];
+	uint8_t frameIdx = atAnimation[p->tiles.aniIdx];
+
+	if (p->tiles.frameIdx != frameIdx)
+	{
+		p->tiles.frameIdx = frameIdx;
+		p->markDirty();
+	}
 
 	if (++p->tiles.aniIdx >= atAnimationN)
 		p->tiles.aniIdx = 0;
@@ -1183,6 +1207,7 @@ void Tilemap::setTileset(Bitmap *value)
 		return;
 
 	p->tileset = value;
+	p->markDirty();
 
 	if (!value)
 		return;
@@ -1192,6 +1217,10 @@ void Tilemap::setTileset(Bitmap *value)
 	p->tilesetCon = value->modified.connect
 	        (sigc::mem_fun(p, &TilemapPrivate::invalidateAtlasSize));
 
+	p->tilesetDispCon.disconnect();
+	p->tilesetDispCon = value->wasDisposed.connect
+	        (sigc::mem_fun(p, &TilemapPrivate::markDirty));
+
 	p->updateAtlasInfo();
 }
 
@@ -1203,6 +1232,7 @@ void Tilemap::setMapData(Table *value)
 		return;
 
 	p->mapData = value;
+	p->markDirty();
 
 	if (!value)
 		return;
@@ -1217,7 +1247,19 @@ void Tilemap::setFlashData(Table *value)
 {
 	guardDisposed();
 
+	if (p->flashMap.getData() == value)
+		return;
+
 	p->flashMap.setData(value);
+	p->markDirty();
+
+	p->flashDataCon.disconnect();
+
+	if (!value)
+		return;
+
+	p->flashDataCon = value->modified.connect
+	        (sigc::mem_fun(p, &TilemapPrivate::markDirty));
 }
 
 void Tilemap::setPriorities(Table *value)
@@ -1228,6 +1270,7 @@ void Tilemap::setPriorities(Table *value)
 		return;
 
 	p->priorities = value;
+	p->markDirty();
 
 	if (!value)
 		return;
@@ -1246,6 +1289,7 @@ void Tilemap::setVisible(bool value)
 		return;
 
 	p->visible = value;
+	p->markDirty();
 
 	if (!p->tilemapReady)
 		return;
@@ -1265,6 +1309,7 @@ void Tilemap::setOX(int value)
 	p->offset.x = value;
 	p->updatePosition();
 	p->mapViewportDirty = true;
+	p->markDirty();
 }
 
 void Tilemap::setOY(int value)
@@ -1278,6 +1323,7 @@ void Tilemap::setOY(int value)
 	p->updatePosition();
 	p->zOrderDirty = true;
 	p->mapViewportDirty = true;
+	p->markDirty();
 }
 
 void Tilemap::releaseResources()
@@ -89,6 +89,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 	sigc::connection mapDataCon;
 	sigc::connection flagsCon;
+	sigc::connection flashDataCon;
 
 	sigc::connection prepareCon;
 	sigc::connection bmChangedCons[BM_COUNT];
@@ -156,6 +157,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 		mapDataCon.disconnect();
 		flagsCon.disconnect();
+		flashDataCon.disconnect();
 
 		for (size_t i = 0; i < BM_COUNT; ++i)
 		{
@@ -167,11 +169,18 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void invalidateAtlas()
 	{
 		atlasDirty = true;
+		markSceneDirty();
 	}
 
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		markSceneDirty();
+	}
+
+	void markDirty()
+	{
+		markSceneDirty();
 	}
 
 	void rebuildAtlas()
@@ -401,7 +410,7 @@ void TilemapVX::BitmapArray::set(int i, Bitmap *bitmap)
 		return;
 
 	p->bitmaps[i] = bitmap;
-	p->atlasDirty = true;
+	p->invalidateAtlas();
 
 	p->bmChangedCons[i].disconnect();
 	p->bmChangedCons[i] = bitmap->modified.connect
@@ -450,11 +459,20 @@ void TilemapVX::update()
 	uint8_t aniIdxA = aniIndicesA[p->frameIdx / 30];
 	uint8_t aniIdxC = aniIndicesC[p->frameIdx / 30];
 
-	p->aniOffset = Vec2(aniIdxA * 2 * 32, aniIdxC * 32);
+	const Vec2 aniOffset(aniIdxA * 2 * 32, aniIdxC * 32);
+
+	if (p->aniOffset.x != aniOffset.x || p->aniOffset.y != aniOffset.y)
+	{
+		p->aniOffset = aniOffset;
+		p->markDirty();
+	}
 
 	/* Animate flash */
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
+
+	if (!p->flashMap.isEmpty())
+		p->markDirty();
 }
 
 TilemapVX::BitmapArray &TilemapVX::getBitmapArray()
@@ -500,7 +518,7 @@ void TilemapVX::setMapData(Table *value)
 		return;
 
 	p->mapData = value;
-	p->buffersDirty = true;
+	p->invalidateBuffers();
 
 	p->mapDataCon.disconnect();
 	p->mapDataCon = value->modified.connect
@@ -511,7 +529,19 @@ void TilemapVX::setFlashData(Table *value)
 {
 	guardDisposed();
 
+	if (p->flashMap.getData() == value)
+		return;
+
 	p->flashMap.setData(value);
+	p->markDirty();
+
+	p->flashDataCon.disconnect();
+
+	if (!value)
+		return;
+
+	p->flashDataCon = value->modified.connect
+		(sigc::mem_fun(p, &TilemapVXPrivate::markDirty));
 }
 
 void TilemapVX::setFlags(Table *value)
@@ -522,7 +552,7 @@ void TilemapVX::setFlags(Table *value)
 		return;
 
 	p->flags = value;
-	p->buffersDirty = true;
+	p->invalidateBuffers();
 
 	p->flagsCon.disconnect();
 	p->flagsCon = value->modified.connect
@@ -546,6 +576,7 @@ void TilemapVX::setOX(int value)
 
 	p->offset.x = value;
 	p->mapViewportDirty = true;
+	p->markDirty();
 }
 
 void TilemapVX::setOY(int value)
@@ -557,6 +588,7 @@ void TilemapVX::setOY(int value)
 
 	p->offset.y = value;
 	p->mapViewportDirty = true;
+	p->markDirty();
 }
 
 void TilemapVX::releaseResources()
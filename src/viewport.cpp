@@ -27,6 +27,9 @@
 #include "quad.h"
 #include "glstate.h"
 #include "graphics.h"
+#include "texpool.h"
+#include "shader.h"
+#include "gl-util.h"
 
 #include <SDL_rect.h>
 
@@ -42,10 +45,28 @@ struct ViewportPrivate
 
 	Color *color;
 	Tone *tone;
+	sigc::connection colorCon;
+	sigc::connection toneCon;
 
 	IntRect screenRect;
 	int isOnScreen;
 
+	/* Render cache for viewports whose contents stay
+	 * unchanged over several frames. Holds the composited
+	 * children (without effects) in premultiplied alpha */
+	struct
+	{
+		TEXFBO tex;
+		Quad quad;
+
+		/* Consecutive composites without content changes */
+		int cleanFrames;
+		/* 'tex' holds the current contents */
+		bool valid;
+		/* Contents can be cached (only normal blending used) */
+		bool usable;
+	} cache;
+
 	EtcTemps tmp;
 
 	ViewportPrivate(int x, int y, int width, int height, Viewport *self)
@@ -55,13 +76,22 @@ struct ViewportPrivate
 	      tone(&tmp.tone),
 	      isOnScreen(false)
 	{
+		cache.cleanFrames = 0;
+		cache.valid = false;
+		cache.usable = true;
+
 		rect->set(x, y, width, height);
 		updateRectCon();
+		updateEffectCons();
 	}
 
 	~ViewportPrivate()
 	{
+		releaseCache();
+
 		rectCon.disconnect();
+		colorCon.disconnect();
+		toneCon.disconnect();
 	}
 
 	void onRectChange()
@@ -78,6 +108,22 @@ struct ViewportPrivate
 		        (sigc::mem_fun(this, &ViewportPrivate::onRectChange));
 	}
 
+	void onEffectChange()
+	{
+		self->markSceneDirty();
+	}
+
+	void updateEffectCons()
+	{
+		colorCon.disconnect();
+		colorCon = color->valueChanged.connect
+		        (sigc::mem_fun(this, &ViewportPrivate::onEffectChange));
+
+		toneCon.disconnect();
+		toneCon = tone->valueChanged.connect
+		        (sigc::mem_fun(this, &ViewportPrivate::onEffectChange));
+	}
+
 	void recomputeOnScreen()
 	{
 		SDL_Rect r1 = { screenRect.x, screenRect.y,
@@ -97,6 +143,40 @@ struct ViewportPrivate
 
 		return (rectEffective && colorToneEffective && isOnScreen);
 	}
+
+	void releaseCache()
+	{
+		cache.valid = false;
+
+		if (cache.tex.tex == TEX::ID(0))
+			return;
+
+		shState->texPool().release(cache.tex);
+		TEXFBO::clear(cache.tex);
+	}
+
+	void drawCache()
+	{
+		const IntRect r = rect->toIntRect();
+		cache.quad.setTexPosRect(r, r);
+
+		SimpleShader &shader = shState->shaders().simple;
+		shader.bind();
+		shader.applyViewportProj();
+		shader.setTranslation(Vec2i());
+		shader.setTexSize(Vec2i(cache.tex.width, cache.tex.height));
+
+		TEX::bind(cache.tex.tex);
+
+		/* Cache contents are premultiplied */
+		gl.BlendEquation(GL_FUNC_ADD);
+		gl.BlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA,
+		                     GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+		cache.quad.draw();
+
+		glState.blendMode.refresh();
+	}
 };
 
 Viewport::Viewport(int x, int y, int width, int height)
@@ -180,6 +260,86 @@ void Viewport::initDynAttribs()
 	p->tone = new Tone;
 
 	p->updateRectCon();
+	p->updateEffectCons();
+}
+
+void Viewport::markDirty()
+{
+	Scene::markDirty();
+
+	/* Our contents are drawn as part of the parent scene */
+	markSceneDirty();
+}
+
+/* Number of unchanged composites after which
+ * a viewport is considered static */
+static const int cacheThreshold = 2;
+
+bool Viewport::compositeCached()
+{
+	if (dirty)
+	{
+		p->cache.cleanFrames = 0;
+		p->cache.usable = true;
+		p->releaseCache();
+
+		return false;
+	}
+
+	if (p->cache.cleanFrames < cacheThreshold)
+	{
+		++p->cache.cleanFrames;
+		return false;
+	}
+
+	if (!p->cache.usable)
+		return false;
+
+	if (!p->cache.valid)
+	{
+		const IntRect &screen = p->screenRect;
+
+		if (p->cache.tex.tex == TEX::ID(0))
+			p->cache.tex = shState->texPool().request(screen.w, screen.h);
+
+		/* Render children with identical projection and scissor
+		 * into the cache. Normal blending onto a cleared target
+		 * yields premultiplied contents, which are composited
+		 * exactly; other blend modes can't be cached */
+		FBO::bind(p->cache.tex.fbo);
+		glState.clearColor.pushSet(Vec4());
+		FBO::clear();
+
+		glState.blendMode.pushSet(BlendNormal);
+		glState.blendMode.nonNormalApplied = false;
+
+		Scene::composite();
+
+		const bool exact = !glState.blendMode.nonNormalApplied;
+
+		glState.blendMode.pop();
+		glState.clearColor.pop();
+
+		scene->restoreRenderTarget();
+
+		if (!exact)
+		{
+			p->cache.usable = false;
+			p->releaseCache();
+
+			return false;
+		}
+
+		p->cache.valid = true;
+	}
+	else
+	{
+		++glState.stats.viewportCacheHits;
+	}
+
+	p->drawCache();
+
+	return true;
 }
 
 /* Scene */
@@ -197,7 +357,8 @@ void Viewport::composite()
 	glState.scissorTest.pushSet(true);
 	glState.scissorBox.pushSet(p->rect->toIntRect());
 
-	Scene::composite();
+	if (!compositeCached())
+		Scene::composite();
 
 	/* If any effects are visible, request parent Scene to
 	 * render them. */
@@ -219,6 +380,15 @@ void Viewport::onGeometryChange(const Geometry &geo)
 {
 	p->screenRect = geo.rect;
 	p->recomputeOnScreen();
+
+	/* Cache is sized after the parent scene */
+	p->releaseCache();
+}
+
+/* Flashable */
+void Viewport::onFlashChange()
+{
+	markSceneDirty();
 }
 
 void Viewport::releaseResources()
@@ -47,13 +47,17 @@ public:
 
 	void initDynAttribs();
 
+	void markDirty();
+
 private:
 	void initViewport(int x, int y, int width, int height);
 	void geometryChanged();
 
 	void composite();
+	bool compositeCached();
 	void draw();
 	void onGeometryChange(const Geometry &);
+	void onFlashChange();
 	bool isEffectiveViewport(Rect *&, Color *&, Tone *&) const;
 
 	void releaseResources();
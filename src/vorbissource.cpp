@@ -73,9 +73,13 @@ struct VorbisSource : ALDataSource
 		int rate;
 		int frameSize;
 		ALenum alFormat;
+
+		/* Samples are handed to OpenAL as vorbis
+		 * decodes them, instead of as int16 */
+		bool floatOut;
 	} info;
 
-	std::vector<int16_t> sampleBuf;
+	std::vector<uint8_t> sampleBuf;
 
 	VorbisSource(SDL_RWops &ops,
 	             bool looped)
@@ -103,10 +107,14 @@ struct VorbisSource : ALDataSource
 			                "Cannot handle audio with more than 2 channels");
 		}
 
-		info.alFormat = chooseALFormat(sizeof(int16_t), info.channels);
-		info.frameSize = sizeof(int16_t) * info.channels;
+		info.floatOut = haveFloatFormats();
+
+		int sampleSize = info.floatOut ? sizeof(float) : sizeof(int16_t);
+		info.alFormat = chooseALFormat(sampleSize, info.channels);
+		info.frameSize = sampleSize * info.channels;
 
-		sampleBuf.resize(STREAM_BUF_SIZE);
+		/* Keep the buffer duration of int16 output either way */
+		sampleBuf.resize(STREAM_BUF_SIZE / (sizeof(int16_t) * info.channels) * info.frameSize);
 
 		loop.requested = looped;
 		loop.valid = false;
@@ -173,29 +181,44 @@ struct VorbisSource : ALDataSource
 			ov_raw_seek(&vf, 0);
 	}
 
-	Status fillBuffer(AL::Buffer::ID alBuffer)
+	/* Decodes up to 'frames' frames into 'dst'. Returns
+	 * the amount of frames decoded, or a negative error */
+	long decode(uint8_t *dst, int frames)
 	{
-		void *bufPtr = sampleBuf.data();
-		int availBuf = sampleBuf.size();
-		int bufUsed  = 0;
+		if (!info.floatOut)
+		{
+			long res = ov_read(&vf, reinterpret_cast<char*>(dst), frames * info.frameSize,
+			                   0, sizeof(int16_t), 1, 0);
 
-		int canRead = availBuf;
+			return res < 0 ? res : res / info.frameSize;
+		}
 
-		Status retStatus = ALDataSource::NoError;
+		float **pcm;
+		long res = ov_read_float(&vf, &pcm, frames, 0);
 
-		bool readAgain = false;
+		/* Interleave the channels */
+		float *out = reinterpret_cast<float*>(dst);
 
-		if (loop.valid)
-		{
-			int tilLoopEnd = loop.end * info.frameSize;
+		for (long i = 0; i < res; ++i)
+			for (int c = 0; c < info.channels; ++c)
+				*out++ = pcm[c][i];
 
-			canRead = std::min(availBuf, tilLoopEnd);
-		}
+		return res;
+	}
 
-		while (canRead > 16)
+	Status fillBuffer(AL::Buffer::ID alBuffer)
+	{
+		const int bufFrames = sampleBuf.size() / info.frameSize;
+		int framesUsed = 0;
+
+		Status retStatus = ALDataSource::NoError;
+
+		bool readAgain = false;
+
+		while (framesUsed < bufFrames)
 		{
-			long res = ov_read(&vf, static_cast<char*>(bufPtr),
-			                   canRead, 0, sizeof(int16_t), 1, 0);
+			long res = decode(&sampleBuf[framesUsed * info.frameSize],
+			                  bufFrames - framesUsed);
 
 			if (res < 0)
 			{
@@ -222,7 +245,7 @@ struct VorbisSource : ALDataSource
 				 * we might be EOF without actually having read
 				 * any data at all yet (which mustn't happen),
 				 * so we try to continue reading some data. */
-				if (bufUsed > 0)
+				if (framesUsed > 0)
 					break;
 
 				if (readAgain)
@@ -236,16 +259,15 @@ struct VorbisSource : ALDataSource
 				readAgain = true;
 			}
 
-			bufUsed += (res / sizeof(int16_t));
-			bufPtr = &sampleBuf[bufUsed];
-			currentFrame += (res / info.frameSize);
+			framesUsed += res;
+			currentFrame += res;
 
 			if (loop.valid && currentFrame >= loop.end)
 			{
 				/* Determine how many frames we're
 				 * over the loop end */
 				int discardFrames = currentFrame - loop.end;
-				bufUsed -= discardFrames * info.channels;
+				framesUsed -= discardFrames;
 
 				retStatus = ALDataSource::WrapAround;
 
@@ -256,13 +278,11 @@ struct VorbisSource : ALDataSource
 
 				break;
 			}
-
-			canRead -= res;
 		}
 
 		if (retStatus != ALDataSource::Error)
 			AL::Buffer::uploadData(alBuffer, info.alFormat, sampleBuf.data(),
-			                       bufUsed*sizeof(int16_t), info.rate);
+			                       framesUsed * info.frameSize, info.rate);
 
 		return retStatus;
 	}
@@ -168,9 +168,15 @@ struct QuadChunk
 
 struct WindowPrivate
 {
+	Window *self;
+
 	Bitmap *windowskin;
+	sigc::connection windowskinCon;
+	sigc::connection windowskinDispCon;
 
 	Bitmap *contents;
+	sigc::connection contentsCon;
+	sigc::connection contentsDispCon;
 
 	bool bgStretch;
 	Rect *cursorRect;
@@ -248,8 +254,9 @@ struct WindowPrivate
 
 	sigc::connection prepareCon;
 
-	WindowPrivate(Viewport *viewport = 0)
-	    : windowskin(0),
+	WindowPrivate(Window *self, Viewport *viewport = 0)
+	    : self(self),
+	      windowskin(0),
 	      contents(0),
 	      bgStretch(true),
 	      cursorRect(&tmp.rect),
@@ -281,12 +288,38 @@ struct WindowPrivate
 	{
 		shState->texPool().release(baseTex);
 		cursorRectCon.disconnect();
+		windowskinCon.disconnect();
+		windowskinDispCon.disconnect();
+		contentsCon.disconnect();
+		contentsDispCon.disconnect();
 		prepareCon.disconnect();
 	}
 
+	void markDirty()
+	{
+		self->markSceneDirty();
+	}
+
 	void markControlVertDirty()
 	{
 		controlsVertDirty = true;
+		markDirty();
+	}
+
+	void refreshBitmapCons(Bitmap *bitmap,
+	                       sigc::connection &modCon,
+	                       sigc::connection &dispCon)
+	{
+		modCon.disconnect();
+		dispCon.disconnect();
+
+		if (!bitmap)
+			return;
+
+		modCon = bitmap->modified.connect
+		        (sigc::mem_fun(this, &WindowPrivate::markDirty));
+		dispCon = bitmap->wasDisposed.connect
+		        (sigc::mem_fun(this, &WindowPrivate::markDirty));
 	}
 
 	void refreshCursorRectCon()
@@ -680,7 +713,7 @@ struct WindowPrivate
 Window::Window(Viewport *viewport)
 	: ViewportElement(viewport)
 {
-	p = new WindowPrivate(viewport);
+	p = new WindowPrivate(this, viewport);
 	onGeometryChange(scene->getGeometry());
 }
 
@@ -695,12 +728,16 @@ void Window::update()
 
 	p->updateControls();
 	p->stepAnimations();
+
+	/* Cursor blinking and pause icon animate every frame */
+	if ((p->active && !p->cursorRect->isEmpty()) || p->pause)
+		markSceneDirty();
 }
 
-DEF_ATTR_SIMPLE(Window, X,          int,     p->position.x)
-DEF_ATTR_SIMPLE(Window, Y,          int,     p->position.y)
 DEF_ATTR_SIMPLE(Window, CursorRect, Rect&,  *p->cursorRect)
 
+DEF_ATTR_RD_SIMPLE(Window, X,               int,     p->position.x)
+DEF_ATTR_RD_SIMPLE(Window, Y,               int,     p->position.y)
 DEF_ATTR_RD_SIMPLE(Window, Windowskin,      Bitmap*, p->windowskin)
 DEF_ATTR_RD_SIMPLE(Window, Contents,        Bitmap*, p->contents)
 DEF_ATTR_RD_SIMPLE(Window, Stretch,         bool,    p->bgStretch)
@@ -718,7 +755,12 @@ void Window::setWindowskin(Bitmap *value)
 {
 	guardDisposed();
 
+	if (p->windowskin == value)
+		return;
+
 	p->windowskin = value;
+	p->refreshBitmapCons(value, p->windowskinCon, p->windowskinDispCon);
+	markSceneDirty();
 
 	if (nullOrDisposed(value))
 		return;
@@ -734,7 +776,9 @@ void Window::setContents(Bitmap *value)
 		return;
 
 	p->contents = value;
+	p->refreshBitmapCons(value, p->contentsCon, p->contentsDispCon);
 	p->controlsVertDirty = true;
+	markSceneDirty();
 
 	if (nullOrDisposed(value))
 		return;
@@ -743,6 +787,28 @@ void Window::setContents(Bitmap *value)
 	p->contentsQuad.setTexPosRect(value->rect(), value->rect());
 }
 
+void Window::setX(int value)
+{
+	guardDisposed();
+
+	if (p->position.x == value)
+		return;
+
+	p->position.x = value;
+	markSceneDirty();
+}
+
+void Window::setY(int value)
+{
+	guardDisposed();
+
+	if (p->position.y == value)
+		return;
+
+	p->position.y = value;
+	markSceneDirty();
+}
+
 void Window::setStretch(bool value)
 {
 	guardDisposed();
@@ -752,6 +818,7 @@ void Window::setStretch(bool value)
 
 	p->bgStretch = value;
 	p->baseVertDirty = true;
+	markSceneDirty();
 }
 
 void Window::setActive(bool value)
@@ -763,6 +830,7 @@ void Window::setActive(bool value)
 
 	p->active = value;
 	p->cursorAniAlphaIdx = 0;
+	markSceneDirty();
 }
 
 void Window::setPause(bool value)
@@ -776,6 +844,7 @@ void Window::setPause(bool value)
 	p->pauseAniAlphaIdx = 0;
 	p->pauseAniQuadIdx = 0;
 	p->controlsVertDirty = true;
+	markSceneDirty();
 }
 
 void Window::setWidth(int value)
@@ -787,6 +856,7 @@ void Window::setWidth(int value)
 
 	p->size.x = value;
 	p->baseVertDirty = true;
+	markSceneDirty();
 }
 
 void Window::setHeight(int value)
@@ -798,6 +868,7 @@ void Window::setHeight(int value)
 
 	p->size.y = value;
 	p->baseVertDirty = true;
+	markSceneDirty();
 }
 
 void Window::setOX(int value)
@@ -809,6 +880,7 @@ void Window::setOX(int value)
 
 	p->contentsOffset.x = value;
 	p->controlsVertDirty = true;
+	markSceneDirty();
 }
 
 void Window::setOY(int value)
@@ -820,6 +892,7 @@ void Window::setOY(int value)
 
 	p->contentsOffset.y = value;
 	p->controlsVertDirty = true;
+	markSceneDirty();
 }
 
 void Window::setOpacity(int value)
@@ -831,6 +904,7 @@ void Window::setOpacity(int value)
 
 	p->opacity = value;
 	p->opacityDirty = true;
+	markSceneDirty();
 }
 
 void Window::setBackOpacity(int value)
@@ -842,6 +916,7 @@ void Window::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->opacityDirty = true;
+	markSceneDirty();
 }
 
 void Window::setContentsOpacity(int value)
@@ -853,6 +928,7 @@ void Window::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+	markSceneDirty();
 }
 
 void Window::initDynAttribs()
@@ -72,6 +72,8 @@ private:
 	const char *klassName() const { return "window"; }
 
 	ABOUT_TO_ACCESS_DISP
+
+	friend struct WindowPrivate;
 };
 
 #endif // WINDOW_H
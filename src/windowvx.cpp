@@ -150,9 +150,15 @@ static elementsN(pauseQuad);
 
 struct WindowVXPrivate
 {
+	WindowVX *self;
+
 	Bitmap *windowskin;
+	sigc::connection windowskinCon;
+	sigc::connection windowskinDispCon;
 
 	Bitmap *contents;
+	sigc::connection contentsCon;
+	sigc::connection contentsDispCon;
 
 	Rect *cursorRect;
 	bool active;
@@ -221,8 +227,9 @@ struct WindowVXPrivate
 
 	Vec2i sceneOffset;
 
-	WindowVXPrivate(int x, int y, int w, int h)
-	    : windowskin(0),
+	WindowVXPrivate(WindowVX *self, int x, int y, int w, int h)
+	    : self(self),
+	      windowskin(0),
 	      contents(0),
 	      cursorRect(&tmp.rect),
 	      active(true),
@@ -277,17 +284,44 @@ struct WindowVXPrivate
 
 		cursorRectCon.disconnect();
 		toneCon.disconnect();
+		windowskinCon.disconnect();
+		windowskinDispCon.disconnect();
+		contentsCon.disconnect();
+		contentsDispCon.disconnect();
 		prepareCon.disconnect();
 	}
 
+	void markDirty()
+	{
+		self->markSceneDirty();
+	}
+
 	void invalidateCursorVert()
 	{
 		cursorVertDirty = true;
+		markDirty();
 	}
 
 	void invalidateBaseTex()
 	{
 		base.texDirty = true;
+		markDirty();
+	}
+
+	void refreshBitmapCons(Bitmap *bitmap,
+	                       sigc::connection &modCon,
+	                       sigc::connection &dispCon)
+	{
+		modCon.disconnect();
+		dispCon.disconnect();
+
+		if (!bitmap)
+			return;
+
+		modCon = bitmap->modified.connect
+		        (sigc::mem_fun(this, &WindowVXPrivate::markDirty));
+		dispCon = bitmap->wasDisposed.connect
+		        (sigc::mem_fun(this, &WindowVXPrivate::markDirty));
 	}
 
 	void refreshCursorRectCon()
@@ -817,14 +851,14 @@ struct WindowVXPrivate
 WindowVX::WindowVX(Viewport *viewport)
     : ViewportElement(viewport, DEF_Z, DEF_SPRITE_Y)
 {
-	p = new WindowVXPrivate(0, 0, 0, 0);
+	p = new WindowVXPrivate(this, 0, 0, 0, 0);
 	onGeometryChange(scene->getGeometry());
 }
 
 WindowVX::WindowVX(int x, int y, int width, int height)
     : ViewportElement(0, DEF_Z, DEF_SPRITE_Y)
 {
-	p = new WindowVXPrivate(x, y, width, height);
+	p = new WindowVXPrivate(this, x, y, width, height);
 	onGeometryChange(scene->getGeometry());
 }
 
@@ -841,6 +875,10 @@ void WindowVX::update()
 
 	p->updatePauseQuad();
 	p->updateCursorAlpha();
+
+	/* Cursor blinking and pause icon animate every frame */
+	if ((p->active && p->cursorVert.count() > 0) || p->pause)
+		markSceneDirty();
 }
 
 void WindowVX::move(int x, int y, int width, int height)
@@ -857,6 +895,7 @@ void WindowVX::move(int x, int y, int width, int height)
 
 	p->geo = IntRect(x, y, size.x, size.y);
 	p->updateBaseQuad();
+	markSceneDirty();
 }
 
 bool WindowVX::isOpen() const
@@ -873,11 +912,11 @@ bool WindowVX::isClosed() const
 	return p->openness == 0;
 }
 
-DEF_ATTR_SIMPLE(WindowVX, X,          int,     p->geo.x)
-DEF_ATTR_SIMPLE(WindowVX, Y,          int,     p->geo.y)
 DEF_ATTR_SIMPLE(WindowVX, CursorRect, Rect&,  *p->cursorRect)
 DEF_ATTR_SIMPLE(WindowVX, Tone,       Tone&,  *p->tone)
 
+DEF_ATTR_RD_SIMPLE(WindowVX, X,               int,     p->geo.x)
+DEF_ATTR_RD_SIMPLE(WindowVX, Y,               int,     p->geo.y)
 DEF_ATTR_RD_SIMPLE(WindowVX, Windowskin,      Bitmap*, p->windowskin)
 DEF_ATTR_RD_SIMPLE(WindowVX, Contents,        Bitmap*, p->contents)
 DEF_ATTR_RD_SIMPLE(WindowVX, Active,          bool,    p->active)
@@ -902,7 +941,9 @@ void WindowVX::setWindowskin(Bitmap *value)
 		return;
 
 	p->windowskin = value;
+	p->refreshBitmapCons(value, p->windowskinCon, p->windowskinDispCon);
 	p->base.texDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setContents(Bitmap *value)
@@ -913,6 +954,8 @@ void WindowVX::setContents(Bitmap *value)
 		return;
 
 	p->contents = value;
+	p->refreshBitmapCons(value, p->contentsCon, p->contentsDispCon);
+	markSceneDirty();
 
 	if (nullOrDisposed(value))
 		return;
@@ -922,6 +965,28 @@ void WindowVX::setContents(Bitmap *value)
 	p->ctrlVertDirty = true;
 }
 
+void WindowVX::setX(int value)
+{
+	guardDisposed();
+
+	if (p->geo.x == value)
+		return;
+
+	p->geo.x = value;
+	markSceneDirty();
+}
+
+void WindowVX::setY(int value)
+{
+	guardDisposed();
+
+	if (p->geo.y == value)
+		return;
+
+	p->geo.y = value;
+	markSceneDirty();
+}
+
 void WindowVX::setActive(bool value)
 {
 	guardDisposed();
@@ -932,6 +997,7 @@ void WindowVX::setActive(bool value)
 	p->active = value;
 	p->cursorAlphaIdx = cursorAlphaResetIdx;
 	p->updateCursorAlpha();
+	markSceneDirty();
 }
 
 void WindowVX::setArrowsVisible(bool value)
@@ -943,6 +1009,7 @@ void WindowVX::setArrowsVisible(bool value)
 
 	p->arrowsVisible = value;
 	p->ctrlVertDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setPause(bool value)
@@ -956,6 +1023,7 @@ void WindowVX::setPause(bool value)
 	p->pauseAlphaIdx = 0;
 	p->pauseQuadIdx = 0;
 	p->ctrlVertDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setWidth(int value)
@@ -972,6 +1040,7 @@ void WindowVX::setWidth(int value)
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
 	p->updateBaseQuad();
+	markSceneDirty();
 }
 
 void WindowVX::setHeight(int value)
@@ -988,6 +1057,7 @@ void WindowVX::setHeight(int value)
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
 	p->updateBaseQuad();
+	markSceneDirty();
 }
 
 void WindowVX::setOX(int value)
@@ -999,6 +1069,7 @@ void WindowVX::setOX(int value)
 
 	p->contentsOff.x = value;
 	p->ctrlVertDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setOY(int value)
@@ -1010,6 +1081,7 @@ void WindowVX::setOY(int value)
 
 	p->contentsOff.y = value;
 	p->ctrlVertDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setPadding(int value)
@@ -1022,6 +1094,7 @@ void WindowVX::setPadding(int value)
 	p->padding = value;
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setPaddingBottom(int value)
@@ -1033,6 +1106,7 @@ void WindowVX::setPaddingBottom(int value)
 
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setOpacity(int value)
@@ -1044,6 +1118,7 @@ void WindowVX::setOpacity(int value)
 
 	p->opacity = value;
 	p->base.quad.setColor(Vec4(1, 1, 1, p->opacity.norm));
+	markSceneDirty();
 }
 
 void WindowVX::setBackOpacity(int value)
@@ -1055,6 +1130,7 @@ void WindowVX::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->base.texDirty = true;
+	markSceneDirty();
 }
 
 void WindowVX::setContentsOpacity(int value)
@@ -1066,6 +1142,7 @@ void WindowVX::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+	markSceneDirty();
 }
 
 void WindowVX::setOpenness(int value)
@@ -1077,6 +1154,7 @@ void WindowVX::setOpenness(int value)
 
 	p->openness = value;
 	p->updateBaseQuad();
+	markSceneDirty();
 }
 
 void WindowVX::initDynAttribs()
@@ -78,6 +78,8 @@ private:
 	const char *klassName() const { return "window"; }
 
 	ABOUT_TO_ACCESS_DISP
+
+	friend struct WindowVXPrivate;
 };
 
 #endif // WINDOWVX_H